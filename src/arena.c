@@ -0,0 +1,132 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "utils.h"
+
+// Bump pointer allocator. Memory is carved out of chunks that are only
+// released all at once when the arena is freed. The most recent allocation
+// can be grown in place, which suits buffers that are appended to while
+// parsing.
+
+struct chunk {
+  struct chunk *next;
+  size_t capacity;
+  size_t used;
+  _Alignas(max_align_t) char data[];
+};
+
+struct arena {
+  struct chunk *head; // Allocations are made from the head chunk
+  void *last;
+};
+
+enum {
+  CHUNK_SIZE = 4096,
+  CHUNK_CAPACITY = CHUNK_SIZE - sizeof(struct chunk),
+};
+
+#define ALIGNMENT _Alignof(max_align_t)
+
+static size_t align_size(size_t size) {
+  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+struct arena *arena_create(void) {
+  struct arena *arena = check(malloc(sizeof(*arena)));
+  arena->head = NULL;
+  arena->last = NULL;
+  return arena;
+}
+
+static struct chunk *chunk_create(size_t capacity) {
+  struct chunk *chunk = check(malloc(sizeof(*chunk) + capacity));
+  chunk->next = NULL;
+  chunk->capacity = capacity;
+  chunk->used = 0;
+  return chunk;
+}
+
+void *arena_alloc(struct arena *arena, size_t size) {
+  if (size > SIZE_MAX - ALIGNMENT - sizeof(struct chunk)) {
+    fatal("Failed to allocate memory");
+  }
+  size = align_size(size ? size : 1);
+  struct chunk *chunk = arena->head;
+  if (!chunk || chunk->capacity - chunk->used < size) {
+    chunk = chunk_create(size > CHUNK_CAPACITY ? size : CHUNK_CAPACITY);
+    chunk->next = arena->head;
+    arena->head = chunk;
+  }
+  void *ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  arena->last = ptr;
+  return ptr;
+}
+
+void *arena_calloc(struct arena *arena, size_t count, size_t size) {
+  if (size && count > SIZE_MAX / size) {
+    fatal("Failed to allocate memory");
+  }
+  return memset(arena_alloc(arena, count * size), 0, count * size);
+}
+
+void *arena_grow(struct arena *arena, void *ptr, size_t old_size, size_t new_size) {
+  struct chunk *chunk = arena->head;
+  if (ptr && ptr == arena->last) {
+    size_t offset = (char *)ptr - chunk->data;
+    if (chunk->capacity - offset >= align_size(new_size)) {
+      chunk->used = offset + align_size(new_size);
+      return ptr;
+    }
+  }
+  void *grown = arena_alloc(arena, new_size);
+  if (ptr) {
+    memcpy(grown, ptr, old_size);
+  }
+  return grown;
+}
+
+char *arena_strndup(struct arena *arena, const char *str, size_t length) {
+  char *copy = arena_alloc(arena, length + 1);
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+char *arena_strdup(struct arena *arena, const char *str) {
+  return arena_strndup(arena, str, strlen(str));
+}
+
+// Move the memory of other into arena. Anything allocated from other stays
+// valid for as long as arena does.
+void arena_merge(struct arena *arena, struct arena *other) {
+  struct chunk *tail = other->head;
+  if (!tail) {
+    return;
+  }
+  while (tail->next) {
+    tail = tail->next;
+  }
+  if (arena->head) {
+    tail->next = arena->head->next;
+    arena->head->next = other->head;
+  } else {
+    arena->head = other->head;
+    arena->last = other->last;
+  }
+  other->head = NULL;
+  other->last = NULL;
+}
+
+void arena_free(struct arena *arena) {
+  struct chunk *chunk = arena->head;
+  while (chunk) {
+    struct chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(arena);
+}
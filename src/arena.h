@@ -0,0 +1,17 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct arena;
+
+struct arena *arena_create(void);
+void *arena_alloc(struct arena *arena, size_t size);
+void *arena_calloc(struct arena *arena, size_t count, size_t size);
+void *arena_grow(struct arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strdup(struct arena *arena, const char *str);
+char *arena_strndup(struct arena *arena, const char *str, size_t length);
+void arena_merge(struct arena *arena, struct arena *other);
+void arena_free(struct arena *arena);
+
+#endif
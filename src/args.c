@@ -5,17 +5,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "utils.h"
 #include "indexer.h"
+#include "keywords.h"
 #include "parser_common.h"
+#include "vector.h"
 #include "style_parser.h"
 #include "styles.h"
+#include "config_cache.h"
 
 static const char *USAGE =
     "Usage: " PACKAGE_NAME " [-p PALETTE] [-s PALETTE] [-S SEPARATOR] [-m METHOD]\n"
     "                   [-M METHOD] [-o INDEX STYLE] [-O INDEX STYLE]\n"
-    "                   [-l] [-c] [-n] [-b] [-h] [-v] [PATH]\n\n"
+    "                   [-l] [-c] [-n] [-b] [-h] [-v] [--snapshot]\n"
+    "                   [--deadline DURATION] [--watch] [--pid PID]\n"
+    "                   [--path-file FILE] [--theme NAME] [--stdin]\n"
+    "                   [--from-file FILE] [-0] [--terminator STRING]\n"
+    "                   [--jobs N] [--stats] [--tree] [--highlight-paths]\n"
+    "                   [--field N] [--delimiter C] [--ls-colors]\n"
+    "                   [--max-latency DURATION] [PATH...]\n"
+    "       " PACKAGE_NAME " [OPTIONS] --input FILE...\n\n"
     "Color path components using a palette.\n\n"
     "Options:\n"
     "  -p, --palette PALETTE                 Semicolon separated list of styles for\n"
@@ -24,12 +35,14 @@ static const char *USAGE =
     "                                        path separators.\n"
     "  -S, --separator SEPARATOR             String used to separate path components\n"
     "                                        in the output (defaults to '/').\n"
+    "      --theme NAME                      Use a built-in theme for the palettes. One of\n"
+    "                                        default, solarized, nord, gruvbox, mono.\n"
     "  -m, --method METHOD                   Method for selecting styles from palette.\n"
-    "                                        One of sequential, hash, random\n"
-    "                                        (defaults to sequential).\n"
+    "                                        One of sequential, hash, random,\n"
+    "                                        random-stable (defaults to sequential).\n"
     "  -M, --separator-method METHOD         Method for selecting styles from separator\n"
-    "                                        palette. One of sequential, hash, random\n"
-    "                                        (defaults to sequential).\n"
+    "                                        palette. One of sequential, hash, random,\n"
+    "                                        random-stable (defaults to sequential).\n"
     "  -o, --override INDEX STYLE            Override style at the given index. This option\n"
     "                                        can appear multiple times.\n"
     "  -O, --separator-override INDEX STYLE  Override separator style at the given index.\n"
@@ -38,8 +51,47 @@ static const char *USAGE =
     "  -c, --compact                         Replace home directory path prefix with ~.\n"
     "  -n, --newline                         Do not append newline.\n"
     "  -b, --bash                            Escape control codes for use in Bash prompts.\n"
+    "      --ls-colors                       Style the last component of paths by its\n"
+    "                                        file type or suffix as given in LS_COLORS.\n"
+    "      --deadline DURATION               Give up on file system access after DURATION\n"
+    "                                        (for example 20ms) and use defaults instead.\n"
+    "      --watch                           Keep running and print the path again when\n"
+    "                                        it or the configuration file changes.\n"
+    "      --pid PID                         Display the working directory of process PID.\n"
+    "      --path-file FILE                  Display the path stored in FILE.\n"
+    "      --stdin                           Color each line read from standard input\n"
+    "                                        as a path.\n"
+    "      --from-file FILE                  Color each line read from FILE as a path.\n"
+    "      --input                           Color each line of the files given as\n"
+    "                                        arguments as a path.\n"
+    "  -0, --null                            Paths read with --stdin, --from-file or\n"
+    "                                        --input are separated by NUL characters\n"
+    "                                        instead of newlines.\n"
+    "      --terminator STRING               String written after each path (defaults\n"
+    "                                        to a newline, or NUL with -0).\n"
+    "      --jobs N                          Render paths read with --stdin, --from-file\n"
+    "                                        or --input using N threads (0 for one\n"
+    "                                        per processor, defaults to 1).\n"
+    "      --max-latency DURATION            Write paths read from input out at most\n"
+    "                                        DURATION after reading them, even while\n"
+    "                                        more input keeps arriving.\n"
+    "      --stats                           Report how often styles and output were\n"
+    "                                        reused for paths read from input.\n"
+    "      --tree                            Display paths read from standard input,\n"
+    "                                        --from-file or --input as an indented tree.\n"
+    "      --highlight-paths                 Color the paths found within lines of text\n"
+    "                                        read from standard input, --from-file or\n"
+    "                                        --input, and leave the rest unchanged.\n"
+    "      --field N                         Color only field N of each line read from\n"
+    "                                        standard input, --from-file or --input,\n"
+    "                                        and leave the rest unchanged. Fields are\n"
+    "                                        separated by spaces and tabs.\n"
+    "      --delimiter C                     Separate fields by the character C (\\t for\n"
+    "                                        a tab) instead.\n"
     "  -h, --help                            Display this help.\n"
-    "  -v, --version                         Display version information.\n";
+    "  -v, --version                         Display version information.\n"
+    "      --snapshot                        Print a snapshot of the configuration file for\n"
+    "                                        exporting in " SNAPSHOT_VARIABLE ".\n";
 
 static void usage(void) {
   fputs(USAGE, stderr);
@@ -49,6 +101,17 @@ static void version(void) {
   fputs(PACKAGE_STRING "\n", stderr);
 }
 
+static bool snapshot(void) {
+  char *snapshot = config_snapshot();
+  if (!snapshot) {
+    fputs("Failed to load configuration file\n", stderr);
+    return false;
+  }
+  puts(snapshot);
+  free(snapshot);
+  return true;
+}
+
 
 static bool consume_argument(char ***arg, char **arg_end, const char *flag) {
   if (++*arg >= arg_end) {
@@ -58,7 +121,8 @@ static bool consume_argument(char ***arg, char **arg_end, const char *flag) {
   return true;
 }
 
-static bool parse_palette_arg(char ***arg,
+static bool parse_palette_arg(struct arena *arena,
+                              char ***arg,
                               char **arg_end,
                               struct palette **result,
                               const char *flag) {
@@ -66,13 +130,10 @@ static bool parse_palette_arg(char ***arg,
     return false;
   }
   struct palette *palette;
-  if (!parse_palette_cstr(**arg, &palette)) {
+  if (!parse_palette_cstr(arena, **arg, &palette)) {
     fputs("Invalid separator palette\n", stderr);
     return false;
   }
-  if (*result) {
-    palette_free(*result);
-  }
   *result = palette;
   return true;
 }
@@ -94,104 +155,356 @@ static bool parse_indexer_arg(char ***arg,
   return true;
 }
 
-static bool parse_override_arg(char ***arg,
+static bool parse_override_arg(struct arena *arena,
+                               char ***arg,
                                char **arg_end,
-                               struct list *result,
+                               struct vector *result,
                                const char *flag) {
-  struct override *override = check(malloc(sizeof(*override)));
+  ssize_t index;
+  struct style *style;
   if (!consume_argument(arg, arg_end, flag)) {
-    goto error;
+    return false;
   }
-  if (!parse_ssize(**arg, &override->raw_index)) {
+  if (!parse_ssize(**arg, &index)) {
     fputs("Invalid override index\n", stderr);
-    goto error;
+    return false;
   }
   if (!consume_argument(arg, arg_end, flag)) {
-    goto error;
+    return false;
   }
-  if (!parse_style_cstr(**arg, &override->style)) {
+  if (!parse_style_cstr(arena, **arg, &style)) {
     fputs("Invalid override style\n", stderr);
-    goto error;
+    return false;
   }
-  list_append(result, override);
+  struct override *override = vector_push(result);
+  override->raw_index = index;
+  override->style = style;
   return true;
- error:
-  free(override);
-  return false;
 }
 
 
+// Map a command-line flag to its keyword. Long flags share their names with
+// the configuration file options.
+static enum keyword flag_keyword(const char *flag) {
+  if (flag[1] == '-') {
+    return keyword_lookup(flag + 2, strlen(flag + 2));
+  }
+  if (!flag[1] || flag[2]) {
+    return KEYWORD_NONE;
+  }
+  switch (flag[1]) {
+  case 'p':
+    return KEYWORD_PALETTE;
+  case 's':
+    return KEYWORD_SEPARATOR_PALETTE;
+  case 'S':
+    return KEYWORD_SEPARATOR;
+  case 'm':
+    return KEYWORD_METHOD;
+  case 'M':
+    return KEYWORD_SEPARATOR_METHOD;
+  case 'o':
+    return KEYWORD_OVERRIDE;
+  case 'O':
+    return KEYWORD_SEPARATOR_OVERRIDE;
+  case 'l':
+    return KEYWORD_STRIP_LEADING;
+  case 'c':
+    return KEYWORD_COMPACT;
+  case 'n':
+    return KEYWORD_NEWLINE;
+  case 'b':
+    return KEYWORD_BASH;
+  case 'h':
+    return KEYWORD_HELP;
+  case 'v':
+    return KEYWORD_VERSION;
+  case '0':
+    return KEYWORD_NULL;
+  default:
+    return KEYWORD_NONE;
+  }
+}
+
 bool parse_args(int argc, char **argv, struct config *config, bool *exit) {
   char **arg = argv + 1;
   char **arg_end = argv + argc;
 
   *exit = false;
+  bool separated = false; // Whether the paths follow --
   for (; arg < arg_end; arg++) {
     const char *flag = *arg;
-    if (!strcmp("--palette", flag) || !strcmp("-p", flag)) {
-      if (!parse_palette_arg(&arg, arg_end, &config->path_palette, flag)) {
+    if (!strcmp("--", flag)) {
+      arg++;
+      separated = true;
+      break;
+    }
+    if (flag[0] != '-') {
+      break;
+    }
+    switch (flag_keyword(flag)) {
+    case KEYWORD_PALETTE:
+      if (!parse_palette_arg(config->arena, &arg, arg_end, &config->path_palette, flag)) {
         goto error;
       }
-    } else if (!strcmp("--separator-palette", flag) || !strcmp("-s", flag)) {
-      if (!parse_palette_arg(&arg, arg_end, &config->separator_palette, flag)) {
+      config->fields |= CONFIG_FIELD_PATH_PALETTE;
+      break;
+    case KEYWORD_SEPARATOR_PALETTE:
+      if (!parse_palette_arg(config->arena, &arg, arg_end, &config->separator_palette, flag)) {
+        goto error;
+      }
+      config->fields |= CONFIG_FIELD_SEPARATOR_PALETTE;
+      break;
+    case KEYWORD_SEPARATOR:
+      if (!consume_argument(&arg, arg_end, flag)) {
         goto error;
       }
-    } else if (!strcmp("--separator", flag) || !strcmp("-S", flag)) {
+      config->separator = arena_strdup(config->arena, *arg);
+      config->fields |= CONFIG_FIELD_SEPARATOR;
+      break;
+    case KEYWORD_THEME:
       if (!consume_argument(&arg, arg_end, flag)) {
         goto error;
       }
-      config->separator = check(strdup(*arg));
-    } else if (!strcmp("--method", flag) || !strcmp("-m", flag)) {
+      config->theme = get_theme(*arg);
+      if (!config->theme) {
+        fputs("Invalid theme\n", stderr);
+        goto error;
+      }
+      config->fields |= CONFIG_FIELD_THEME;
+      break;
+    case KEYWORD_METHOD:
       if (!parse_indexer_arg(&arg, arg_end, &config->path_indexer, flag)) {
         goto error;
       }
-    } else if (!strcmp("--separator-method", flag) || !strcmp("-M", flag)) {
+      config->fields |= CONFIG_FIELD_PATH_INDEXER;
+      break;
+    case KEYWORD_SEPARATOR_METHOD:
       if (!parse_indexer_arg(&arg, arg_end, &config->separator_indexer, flag)) {
         goto error;
       }
-    } else if (!strcmp("--override", flag) || !strcmp("-o", flag)) {
-      if (!parse_override_arg(&arg, arg_end, config->path_overrides, flag)) {
+      config->fields |= CONFIG_FIELD_SEPARATOR_INDEXER;
+      break;
+    case KEYWORD_OVERRIDE:
+      if (!parse_override_arg(config->arena, &arg, arg_end, config->path_overrides, flag)) {
         goto error;
       }
-    } else if (!strcmp("--separator-override", flag) || !strcmp("-O", flag)) {
-      if (!parse_override_arg(&arg, arg_end, config->separator_overrides, flag)) {
+      break;
+    case KEYWORD_SEPARATOR_OVERRIDE:
+      if (!parse_override_arg(config->arena, &arg, arg_end, config->separator_overrides, flag)) {
         goto error;
       }
-    } else if (!strcmp("--strip-leading", flag) || !strcmp("-l", flag)) {
+      break;
+    case KEYWORD_STRIP_LEADING:
       config->strip_leading = true;
-    } else if (!strcmp("--compact", flag) || !strcmp("-c", flag)) {
+      config->fields |= CONFIG_FIELD_STRIP_LEADING;
+      break;
+    case KEYWORD_COMPACT:
       config->compact = true;
-    } else if (!strcmp("--newline", flag) || !strcmp("-n", flag)) {
+      config->fields |= CONFIG_FIELD_COMPACT;
+      break;
+    case KEYWORD_NEWLINE:
       config->new_line = false;
-    } else if (!strcmp("--bash", flag) || !strcmp("-b", flag)) {
+      config->fields |= CONFIG_FIELD_NEW_LINE;
+      break;
+    case KEYWORD_BASH:
       config->bash_escape = true;
-    } else if (!strcmp("--help", flag) || !strcmp("-h", flag)) {
+      config->fields |= CONFIG_FIELD_BASH_ESCAPE;
+      break;
+    case KEYWORD_DEADLINE:
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      if (!parse_duration(*arg, &config->deadline)) {
+        fputs("Invalid deadline\n", stderr);
+        goto error;
+      }
+      break;
+    case KEYWORD_WATCH:
+      config->watch = true;
+      break;
+    case KEYWORD_PID: {
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      ssize_t pid;
+      if (!parse_ssize(*arg, &pid) || pid <= 0) {
+        fputs("Invalid process ID\n", stderr);
+        goto error;
+      }
+      config->pid = pid;
+      break;
+    }
+    case KEYWORD_PATH_FILE:
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      config->path_file = *arg;
+      break;
+    case KEYWORD_STDIN:
+      config->stream = true;
+      break;
+    case KEYWORD_FROM_FILE:
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      config->from_file = *arg;
+      break;
+    case KEYWORD_INPUT:
+      config->input = true;
+      break;
+    case KEYWORD_NULL:
+      config->delimiter = '\0';
+      break;
+    case KEYWORD_TERMINATOR:
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      config->terminator = *arg;
+      break;
+    case KEYWORD_JOBS: {
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      ssize_t jobs;
+      if (!parse_ssize(*arg, &jobs) || jobs < 0) {
+        fputs("Invalid number of jobs\n", stderr);
+        goto error;
+      }
+      config->jobs = jobs;
+      if (!jobs) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        config->jobs = processors > 0 ? processors : 1;
+      }
+      break;
+    }
+    case KEYWORD_MAX_LATENCY:
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      if (!parse_duration(*arg, &config->max_latency)) {
+        fputs("Invalid maximum latency\n", stderr);
+        goto error;
+      }
+      break;
+    case KEYWORD_STATS:
+      config->stats = true;
+      break;
+    case KEYWORD_TREE:
+      config->tree = true;
+      break;
+    case KEYWORD_HIGHLIGHT_PATHS:
+      config->highlight_paths = true;
+      break;
+    case KEYWORD_LS_COLORS:
+      config->ls_colors = true;
+      break;
+    case KEYWORD_FIELD: {
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      ssize_t field;
+      if (!parse_ssize(*arg, &field) || field <= 0) {
+        fputs("Invalid field number\n", stderr);
+        goto error;
+      }
+      config->record_field = field;
+      break;
+    }
+    case KEYWORD_DELIMITER:
+      if (!consume_argument(&arg, arg_end, flag)) {
+        goto error;
+      }
+      if (!strcmp(*arg, "\\t")) {
+        config->field_delimiter = '\t';
+      } else if (strlen(*arg) == 1) {
+        config->field_delimiter = (unsigned char)**arg;
+      } else {
+        fputs("Invalid field delimiter\n", stderr);
+        goto error;
+      }
+      break;
+    case KEYWORD_HELP:
       usage();
       return false;
-    } else if (!strcmp("--version", flag) || !strcmp("-v", flag)) {
+    case KEYWORD_VERSION:
       version();
       *exit = true;
       return true;
-    } else if (!strcmp("--", flag)) {
-      arg++;
-      break;
-    } else if (!strncmp("--", flag, 2) || !strncmp("-", flag, 1)) {
+    case KEYWORD_SNAPSHOT:
+      *exit = true;
+      return snapshot();
+    default:
       fprintf(stderr, "Invalid usage: unknown option %s\n", flag);
       goto error;
-    } else {
-      break;
     }
   }
 
-  if (arg_end > arg + 1) {
-    usage();
+  config->paths = arg;
+  config->path_count = arg_end - arg;
+
+  // Options are only parsed before the first PATH, so ones given after it
+  // would be taken for paths
+  for (; !separated && arg < arg_end; arg++) {
+    if ((*arg)[0] == '-') {
+      fprintf(stderr, "Invalid usage: option %s given after PATH (use -- before "
+              "paths starting with -)\n", *arg);
+      goto error;
+    }
+  }
+
+  if (config->input && !config->path_count) {
+    fputs("Invalid usage: --input requires at least one FILE\n", stderr);
+    goto error;
+  }
+
+  if (config->tree && config->path_count && !config->input) {
+    fputs("Invalid usage: --tree displays paths read from input\n", stderr);
     goto error;
   }
 
-  if (arg_end == arg) {
-    config->path = NULL;
-  } else {
-    config->path = *arg;
+  if (config->highlight_paths && config->path_count && !config->input) {
+    fputs("Invalid usage: --highlight-paths colors paths in text read from input\n", stderr);
+    goto error;
+  }
+
+  if (config->record_field && config->path_count && !config->input) {
+    fputs("Invalid usage: --field colors a field of records read from input\n", stderr);
+    goto error;
+  }
+
+  if (config->field_delimiter != FIELD_BLANKS && !config->record_field) {
+    fputs("Invalid usage: --delimiter requires --field\n", stderr);
+    goto error;
+  }
+
+  if (config->tree && (config->highlight_paths || config->record_field)) {
+    fputs("Invalid usage: --tree cannot be combined with --highlight-paths or "
+          "--field\n", stderr);
+    goto error;
+  }
+
+  // Trees, text and fields are read from standard input unless files are
+  // given
+  if ((config->tree || config->highlight_paths || config->record_field)
+      && !config->from_file && !config->input) {
+    config->stream = true;
+  }
+
+  if ((config->path_count != 0)
+      + (config->pid != 0)
+      + (config->path_file != NULL)
+      + config->stream
+      + (config->from_file != NULL) > 1) {
+    fputs("Invalid usage: PATH, --pid, --path-file, --stdin and --from-file are "
+          "mutually exclusive\n", stderr);
+    goto error;
+  }
+
+  if (config->watch
+      && (config->path_count > 1 || config->stream || config->from_file || config->input)) {
+    fputs("Invalid usage: --watch displays a single path\n", stderr);
+    goto error;
   }
 
   return true;
@@ -6,6 +6,7 @@
 #include <inttypes.h>
 #include <stddef.h>
 
+#include "terminfo.h"
 #include "utils.h"
 
 struct term_cap {
@@ -13,6 +14,7 @@ struct term_cap {
   int colors;
 };
 
+// Used when no terminfo entry can be found for the terminal
 static const struct term_cap TERMINALS[] = {
   { "linux", 8 },
   { "xterm", 8 },
@@ -22,15 +24,45 @@ static const struct term_cap TERMINALS[] = {
   { "alacritty", 256 },
 };
 
+static const char *ANSI_STRINGS[TERMINFO_STRING_COUNT] = {
+  [TERMINFO_SETAF] = "\e[38;5;%p1%dm",
+  [TERMINFO_SETAB] = "\e[48;5;%p1%dm",
+  [TERMINFO_BOLD] = "\e[1m",
+  [TERMINFO_DIM] = "\e[2m",
+  [TERMINFO_SMUL] = "\e[4m",
+  [TERMINFO_BLINK] = "\e[5m",
+  [TERMINFO_SGR0] = "\e[0m",
+};
+
 struct terminal {
   int color_count;
+  const char *strings[TERMINFO_STRING_COUNT];
+  struct terminfo terminfo;
 };
 
 #define DEFAULT_COLOR_COUNT 256
+#define SEQUENCE_SIZE 64
 
-struct terminal *terminal_create(void) {
-  struct terminal *terminal = check(malloc(sizeof(*terminal)));
+static bool truecolor_terminal(void) {
+  const char *colorterm = get_env("COLORTERM");
+  return colorterm
+    && (!strcmp(colorterm, "truecolor") || !strcmp(colorterm, "24bit"));
+}
+
+static void adjust_for_truecolor(struct terminal *terminal) {
+  // Terminals advertising direct color support handle at least the 256 color
+  // palette, even if their terminfo entry claims otherwise
+  if (terminal->color_count < 256 && truecolor_terminal()) {
+    terminal->color_count = 256;
+    terminal->strings[TERMINFO_SETAF] = ANSI_STRINGS[TERMINFO_SETAF];
+    terminal->strings[TERMINFO_SETAB] = ANSI_STRINGS[TERMINFO_SETAB];
+  }
+}
+
+struct terminal *terminal_create_fallback(void) {
+  struct terminal *terminal = check(calloc(1, sizeof(*terminal)));
   terminal->color_count = DEFAULT_COLOR_COUNT;
+  memcpy(terminal->strings, ANSI_STRINGS, sizeof(ANSI_STRINGS));
   const char *term = get_env("TERM");
   if (term) {
     for (size_t i = 0; i < ARRAY_SIZE(TERMINALS); i++) {
@@ -40,6 +72,21 @@ struct terminal *terminal_create(void) {
       }
     }
   }
+  adjust_for_truecolor(terminal);
+  return terminal;
+}
+
+struct terminal *terminal_create(void) {
+  struct terminfo terminfo = { 0 };
+  const char *term = get_env("TERM");
+  if (!term || !terminfo_load(term, &terminfo)) {
+    return terminal_create_fallback();
+  }
+  struct terminal *terminal = check(calloc(1, sizeof(*terminal)));
+  terminal->terminfo = terminfo;
+  terminal->color_count = terminfo.colors > 0 ? terminfo.colors : 0;
+  memcpy(terminal->strings, terminfo.strings, sizeof(terminal->strings));
+  adjust_for_truecolor(terminal);
   return terminal;
 }
 
@@ -47,35 +94,47 @@ int terminal_color_count(struct terminal *terminal) {
   return terminal->color_count;
 }
 
-void terminal_fg(UNUSED struct terminal *terminal, uint8_t color) {
-  printf("\e[38;5;%" PRIu8 "m", color);
+static void put_string(struct terminal *terminal,
+                       struct bytes *out,
+                       enum terminfo_string string,
+                       int param) {
+  char sequence[SEQUENCE_SIZE];
+  const char *cap = terminal->strings[string];
+  size_t length;
+  if (cap && (length = terminfo_expand(cap, param, sequence, sizeof(sequence)))) {
+    bytes_append(out, sequence, length);
+  }
+}
+
+void terminal_fg(struct terminal *terminal, struct bytes *out, uint8_t color) {
+  put_string(terminal, out, TERMINFO_SETAF, color);
 }
-void terminal_bg(UNUSED struct terminal *terminal, uint8_t color) {
-  printf("\e[48;5;%" PRIu8 "m", color);
+
+void terminal_bg(struct terminal *terminal, struct bytes *out, uint8_t color) {
+  put_string(terminal, out, TERMINFO_SETAB, color);
 }
 
-void terminal_bold(UNUSED struct terminal *terminal) {
-  fputs("\e[1m", stdout);
+void terminal_bold(struct terminal *terminal, struct bytes *out) {
+  put_string(terminal, out, TERMINFO_BOLD, 0);
 }
 
-void terminal_dim(UNUSED struct terminal *terminal) {
-  fputs("\e[2m", stdout);
+void terminal_dim(struct terminal *terminal, struct bytes *out) {
+  put_string(terminal, out, TERMINFO_DIM, 0);
 }
 
-void terminal_underlined(UNUSED struct terminal *terminal) {
-  fputs("\e[4m", stdout);
+void terminal_underlined(struct terminal *terminal, struct bytes *out) {
+  put_string(terminal, out, TERMINFO_SMUL, 0);
 }
 
-void terminal_blink(UNUSED struct terminal *terminal) {
-  fputs("\e[5m", stdout);
+void terminal_blink(struct terminal *terminal, struct bytes *out) {
+  put_string(terminal, out, TERMINFO_BLINK, 0);
 }
 
-void terminal_reset_style(UNUSED struct terminal *terminal) {
-  fputs("\e[0m", stdout);
+void terminal_reset_style(struct terminal *terminal, struct bytes *out) {
+  put_string(terminal, out, TERMINFO_SGR0, 0);
 }
 
 void terminal_free(struct terminal *terminal) {
+  terminfo_free(&terminal->terminfo);
   free(terminal);
 }
-
-
@@ -2,36 +2,72 @@
 #include "utils.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 enum {
   INITIAL_BYTES_SIZE = 32
 };
 
+// Buffers created with an arena live in the arena, others on the heap
+
 struct bytes {
+  struct arena *arena;
   char *data;
   size_t size;
   size_t cap;
 };
 
-struct bytes *bytes_create(void) {
-  struct bytes *bytes = check(malloc(sizeof(*bytes)));
-  char *data = check(malloc(INITIAL_BYTES_SIZE));
+struct bytes *bytes_create(struct arena *arena) {
+  struct bytes *bytes;
+  if (arena) {
+    bytes = arena_alloc(arena, sizeof(*bytes));
+    bytes->data = arena_alloc(arena, INITIAL_BYTES_SIZE);
+  } else {
+    bytes = check(malloc(sizeof(*bytes)));
+    bytes->data = check(malloc(INITIAL_BYTES_SIZE));
+  }
+  bytes->arena = arena;
   bytes->size = 0;
   bytes->cap = INITIAL_BYTES_SIZE;
-  bytes->data = data;
   return bytes;
 }
 
-void bytes_append_char(struct bytes *bytes, char c) {
-  if (bytes->size >= bytes->cap) {
-    size_t new_cap = bytes->cap * 2;
+static void bytes_reserve(struct bytes *bytes, size_t size) {
+  if (bytes->size + size <= bytes->cap) {
+    return;
+  }
+  size_t new_cap = bytes->cap * 2;
+  while (new_cap < bytes->size + size) {
+    new_cap *= 2;
+  }
+  if (bytes->arena) {
+    bytes->data = arena_grow(bytes->arena, bytes->data, bytes->size, new_cap);
+  } else {
     bytes->data = check(realloc(bytes->data, new_cap));
-    bytes->cap = new_cap;
   }
+  bytes->cap = new_cap;
+}
+
+void bytes_append_char(struct bytes *bytes, char c) {
+  bytes_reserve(bytes, 1);
   *(bytes->data + bytes->size) = c;
   bytes->size++;
 }
 
+void bytes_append(struct bytes *bytes, const void *data, size_t size) {
+  bytes_reserve(bytes, size);
+  memcpy(bytes->data + bytes->size, data, size);
+  bytes->size += size;
+}
+
+// Grow the buffer by size bytes and return the start of the added space
+char *bytes_extend(struct bytes *bytes, size_t size) {
+  bytes_reserve(bytes, size);
+  char *pos = bytes->data + bytes->size;
+  bytes->size += size;
+  return pos;
+}
+
 size_t bytes_size(const struct bytes *bytes) {
   return bytes->size;
 }
@@ -40,13 +76,29 @@ const char *bytes_data(const struct bytes *bytes) {
   return bytes->data;
 }
 
+// Empty the buffer, keeping its capacity
+void bytes_clear(struct bytes *bytes) {
+  bytes->size = 0;
+}
+
+// Drop the bytes from size onwards
+void bytes_truncate(struct bytes *bytes, size_t size) {
+  if (size < bytes->size) {
+    bytes->size = size;
+  }
+}
+
 char *bytes_take(struct bytes *bytes) {
   char *ret = bytes->data;
-  free(bytes);
+  if (!bytes->arena) {
+    free(bytes);
+  }
   return ret;
 }
 
 void bytes_free(struct bytes *bytes) {
-  free(bytes->data);
-  free(bytes);
+  if (!bytes->arena) {
+    free(bytes->data);
+    free(bytes);
+  }
 }
@@ -3,12 +3,18 @@
 
 #include <stddef.h>
 
+#include "arena.h"
+
 struct bytes;
 
-struct bytes *bytes_create(void);
+struct bytes *bytes_create(struct arena *arena);
 size_t bytes_size(const struct bytes *bytes);
 void bytes_append_char(struct bytes *bytes, char c);
+void bytes_append(struct bytes *bytes, const void *data, size_t size);
+char *bytes_extend(struct bytes *bytes, size_t size);
 const char *bytes_data(const struct bytes *bytes);
+void bytes_clear(struct bytes *bytes);
+void bytes_truncate(struct bytes *bytes, size_t size);
 char *bytes_take(struct bytes *bytes);
 void bytes_free(struct bytes *bytes);
 
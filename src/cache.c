@@ -0,0 +1,80 @@
+#include "build.h"
+
+#include "cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "utils.h"
+
+// Per-user cache files stored under the cache directory. Cache files are
+// replaced atomically so that concurrent readers never observe partial
+// contents.
+
+static char *cache_path(const char *name) {
+  char *directory = get_cache_directory();
+  if (!directory) {
+    return NULL;
+  }
+  char *path = check_asprintf("%s/%s", directory, name);
+  free(directory);
+  return path;
+}
+
+bool cache_map(const char *name, const char **data, size_t *length) {
+  char *path = cache_path(name);
+  if (!path) {
+    return false;
+  }
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  free(path);
+  if (fd < 0) {
+    return false;
+  }
+  bool ret = false;
+  struct stat buf;
+  if (fstat(fd, &buf) != 0 || buf.st_size == 0) {
+    goto out;
+  }
+  void *data_ = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data_ == MAP_FAILED) {
+    goto out;
+  }
+  *data = data_;
+  *length = buf.st_size;
+  ret = true;
+ out:
+  close(fd);
+  return ret;
+}
+
+void cache_unmap(const char *data, size_t length) {
+  munmap((void *)data, length);
+}
+
+void cache_store(const char *name, const char *data, size_t length) {
+  char *directory = get_cache_directory();
+  if (!directory) {
+    return;
+  }
+  bool created = make_directories(directory);
+  free(directory);
+  if (!created) {
+    return;
+  }
+  char *path = cache_path(name);
+  char *tmp_path = check_asprintf("%s.%ld", path, (long)getpid());
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd >= 0) {
+    bool written = write_all(fd, data, length);
+    if (close(fd) != 0 || !written || rename(tmp_path, path) != 0) {
+      unlink(tmp_path);
+    }
+  }
+  free(tmp_path);
+  free(path);
+}
@@ -0,0 +1,11 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool cache_map(const char *name, const char **data, size_t *length);
+void cache_unmap(const char *data, size_t length);
+void cache_store(const char *name, const char *data, size_t length);
+
+#endif
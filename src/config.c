@@ -5,22 +5,37 @@
 #include "config_parser.h"
 #include "style_parser.h"
 #include "indexer.h"
+#include "config_cache.h"
+#include "keywords.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define CONFIG_FILE "rainbowpath.conf"
 #define MOD(a,b) ((((a)%(b))+(b))%(b))
 
-static inline bool file_exists(const char *path) {
-  struct stat buf = { 0 };
-  return stat(path, &buf) == 0 && S_ISREG(buf.st_mode);
+static inline bool file_exists(const char *path, struct stat *buf) {
+  return stat(path, buf) == 0 && S_ISREG(buf->st_mode);
 }
 
-static char *get_config_path(void) {
-  const char *xdg_config_home;
+// Path of the configuration file in the user's configuration directory, or
+// NULL if there is none
+static char *user_config_path(const char *home) {
+  const char *xdg_config_home = get_env("XDG_CONFIG_HOME");
+  if (xdg_config_home) {
+    return check_asprintf("%s/" PACKAGE_NAME "/" CONFIG_FILE, xdg_config_home);
+  }
+  if (home) {
+    return check_asprintf("%s/.config/" PACKAGE_NAME "/" CONFIG_FILE, home);
+  }
+  return NULL;
+}
+
+static char *get_config_path(struct stat *buf) {
   const char *xdg_config_dirs;
   const char *home = get_home_directory();
   char *path;
@@ -28,17 +43,12 @@ static char *get_config_path(void) {
     return NULL;
   }
   path = check_asprintf("%s/." CONFIG_FILE, home);
-  if (file_exists(path)) {
+  if (file_exists(path, buf)) {
     return path;
   }
   free(path);
-  xdg_config_home = get_env("XDG_CONFIG_HOME");
-  if (xdg_config_home) {
-    path = check_asprintf("%s/" PACKAGE_NAME "/" CONFIG_FILE, xdg_config_home);
-  } else {
-    path = check_asprintf("%s/.config/" PACKAGE_NAME "/" CONFIG_FILE, home);
-  }
-  if (file_exists(path)) {
+  path = user_config_path(home);
+  if (file_exists(path, buf)) {
     return path;
   }
   free(path);
@@ -51,7 +61,7 @@ static char *get_config_path(void) {
          component;
          component = strtok_r(NULL, ":", &state)) {
       path = check_asprintf("%s/" PACKAGE_NAME "/" CONFIG_FILE, component);
-      if (file_exists(path)) {
+      if (file_exists(path, buf)) {
         free(dirs);
         return path;
       }
@@ -60,28 +70,69 @@ static char *get_config_path(void) {
     free(dirs);
   }
   path = SYSCONFDIR "/xdg/" PACKAGE_NAME "/" CONFIG_FILE;
-  if (file_exists(path)) {
+  if (file_exists(path, buf)) {
     return check(strdup(path));
   }
   return NULL;
 }
 
-static bool option_load_palette(struct option *option, struct palette **palette) {
+// Paths at which the configuration file may change: the per-user ones,
+// whether a file exists there yet or not, followed by the file in use when it
+// is elsewhere. Returns the number of paths stored.
+size_t config_watch_paths(char *paths[CONFIG_WATCH_PATHS]) {
+  size_t count = 0;
+  const char *home = get_home_directory();
+  if (home) {
+    paths[count++] = check_asprintf("%s/." CONFIG_FILE, home);
+  }
+  char *path = user_config_path(home);
+  if (path) {
+    paths[count++] = path;
+  }
+  struct stat buf;
+  path = get_config_path(&buf);
+  for (size_t i = 0; path && i < count; i++) {
+    if (!strcmp(paths[i], path)) {
+      free(path);
+      path = NULL;
+    }
+  }
+  if (path) {
+    paths[count++] = path;
+  }
+  return count;
+}
+
+static bool option_load_palette(struct arena *arena,
+                                struct option *option,
+                                struct palette **palette) {
   if (option_kind(option) != OPTION_KIND_STRING) {
     return false;
   }
   const char *string = option_string_value(option);
   struct palette *palette_;
-  if (!parse_palette_cstr(string, &palette_)) {
+  if (!parse_palette_cstr(arena, string, &palette_)) {
     return false;
   }
-  if (*palette) {
-    palette_free(*palette);
-  }
   *palette = palette_;
   return true;
 }
 
+static bool option_load_theme(struct option *option, const struct theme **theme) {
+  if (option_kind(option) != OPTION_KIND_STRING) {
+    return false;
+  }
+  if (option_has_index(option)) {
+    return false;
+  }
+  const struct theme *theme_ = get_theme(option_string_value(option));
+  if (!theme_) {
+    return false;
+  }
+  *theme = theme_;
+  return true;
+}
+
 static bool option_load_bool(struct option *option, bool *value) {
   if (option_kind(option) != OPTION_KIND_BOOL) {
     return false;
@@ -100,9 +151,6 @@ static bool option_load_string(struct option *option, char **value) {
   if (option_has_index(option)) {
     return false;
   }
-  if (*value) {
-    free(*value);
-  }
   *value = option_take_string_value(option);
   return true;
 }
@@ -122,139 +170,334 @@ static bool option_load_indexer(struct option *option, indexer_t *indexer) {
   return true;
 }
 
-static bool option_load_override(struct option *option, struct list *overrides) {
+static bool option_load_override(struct arena *arena,
+                                 struct option *option,
+                                 struct vector *overrides) {
   if (option_kind(option) != OPTION_KIND_STRING) {
     return false;
   }
   if (!option_has_index(option)) {
     return false;
   }
-  struct override *override = check(malloc(sizeof(*override)));
+  struct style *style;
+  if (!parse_style_cstr(arena, option_string_value(option), &style)) {
+    return false;
+  }
+  struct override *override = vector_push(overrides);
   override->raw_index = option_index(option);
-  if (!parse_style_cstr(option_string_value(option), &override->style)) {
-    free(override);
+  override->style = style;
+  return true;
+}
+
+// Field an option sets, zero if the option does not correspond to a field
+static unsigned int option_field(enum keyword keyword) {
+  switch (keyword) {
+  case KEYWORD_PALETTE:
+    return CONFIG_FIELD_PATH_PALETTE;
+  case KEYWORD_SEPARATOR_PALETTE:
+    return CONFIG_FIELD_SEPARATOR_PALETTE;
+  case KEYWORD_THEME:
+    return CONFIG_FIELD_THEME;
+  case KEYWORD_SEPARATOR:
+    return CONFIG_FIELD_SEPARATOR;
+  case KEYWORD_METHOD:
+    return CONFIG_FIELD_PATH_INDEXER;
+  case KEYWORD_SEPARATOR_METHOD:
+    return CONFIG_FIELD_SEPARATOR_INDEXER;
+  case KEYWORD_STRIP_LEADING:
+    return CONFIG_FIELD_STRIP_LEADING;
+  case KEYWORD_COMPACT:
+    return CONFIG_FIELD_COMPACT;
+  case KEYWORD_NEWLINE:
+    return CONFIG_FIELD_NEW_LINE;
+  case KEYWORD_BASH:
+    return CONFIG_FIELD_BASH_ESCAPE;
+  default:
+    return 0;
+  }
+}
+
+struct loader {
+  struct config *config;
+  unsigned int skip; // Fields that are not loaded from the file
+  bool skipped; // Whether any option was skipped
+};
+
+static bool loader_accept(void *ctx, const struct string_view *name) {
+  struct loader *loader = ctx;
+  unsigned int field = option_field(keyword_lookup(name->data, name->length));
+  if (field & loader->skip) {
+    loader->skipped = true;
     return false;
   }
-  list_append(overrides, override);
   return true;
 }
 
-static bool config_load_path(struct config *config, const char *path) {
+static bool loader_option(void *ctx, struct option *option) {
+  struct loader *loader = ctx;
+  struct config *config = loader->config;
+  const struct string_view *name = option_name(option);
+  enum keyword keyword = keyword_lookup(name->data, name->length);
+  bool valid;
+  switch (keyword) {
+  case KEYWORD_PALETTE:
+    valid = option_load_palette(config->arena, option, &config->path_palette);
+    break;
+  case KEYWORD_SEPARATOR_PALETTE:
+    valid = option_load_palette(config->arena, option, &config->separator_palette);
+    break;
+  case KEYWORD_THEME:
+    valid = option_load_theme(option, &config->theme);
+    break;
+  case KEYWORD_SEPARATOR:
+    valid = option_load_string(option, &config->separator);
+    break;
+  case KEYWORD_METHOD:
+    valid = option_load_indexer(option, &config->path_indexer);
+    break;
+  case KEYWORD_SEPARATOR_METHOD:
+    valid = option_load_indexer(option, &config->separator_indexer);
+    break;
+  case KEYWORD_OVERRIDE:
+    valid = option_load_override(config->arena, option, config->path_overrides);
+    break;
+  case KEYWORD_SEPARATOR_OVERRIDE:
+    valid = option_load_override(config->arena, option, config->separator_overrides);
+    break;
+  case KEYWORD_STRIP_LEADING:
+    valid = option_load_bool(option, &config->strip_leading);
+    break;
+  case KEYWORD_COMPACT:
+    valid = option_load_bool(option, &config->compact);
+    break;
+  case KEYWORD_NEWLINE:
+    valid = option_load_bool(option, &config->new_line);
+    break;
+  case KEYWORD_BASH:
+    valid = option_load_bool(option, &config->bash_escape);
+    break;
+  default:
+    fprintf(stderr, "Line %zu, column %zu: Invalid option '%.*s'\n",
+            option_line(option), option_name_column(option),
+            (int)name->length, name->data);
+    return false;
+  }
+  if (!valid) {
+    fprintf(stderr, "Line %zu, column %zu: Invalid value for option '%.*s'\n",
+            option_line(option), option_column(option),
+            (int)name->length, name->data);
+    return false;
+  }
+  config->fields |= option_field(keyword);
+  return true;
+}
+
+// Load the configuration file at path. Options for fields in skip are
+// skipped without parsing their values, complete tells whether that
+// happened.
+static bool config_load_path(struct config *config,
+                             const char *path,
+                             struct stat *buf,
+                             unsigned int skip,
+                             bool *complete) {
   bool ret = false;
-  FILE *handle = fopen(path, "r");
-  if (!handle) {
+  bool mapped = false;
+  struct mapped_file file;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
     goto out;
   }
-  char *data = NULL;
-  size_t data_len;
-  if (!read_stream(handle, &data, &data_len)) {
+  if (fstat(fd, buf) != 0) {
     goto out;
   }
-  struct list *options = NULL;
-  if (!parse_config(data, data + data_len, &options)) {
+  if (!map_file(fd, buf, &file)) {
     goto out;
   }
-  struct list_elem *elem = list_first(options);
-  while (elem) {
-    struct option *option = list_elem_value(elem);
-    const char *name = option_name(option);
-    if (!strcmp(name, "palette")) {
-      if (!option_load_palette(option, &config->path_palette)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "separator-palette")) {
-      if (!option_load_palette(option, &config->separator_palette)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "separator")) {
-      if (!option_load_string(option, &config->separator)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "method")) {
-      if (!option_load_indexer(option, &config->path_indexer)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "separator-method")) {
-      if (!option_load_indexer(option, &config->separator_indexer)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "override")) {
-      if (!option_load_override(option, config->path_overrides)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "separator-override")) {
-      if (!option_load_override(option, config->separator_overrides)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "strip-leading")) {
-      if (!option_load_bool(option, &config->strip_leading)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "compact")) {
-      if (!option_load_bool(option, &config->compact)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "newline")) {
-      if (!option_load_bool(option, &config->new_line)) {
-        goto out;
-      }
-    } else if (!strcmp(name, "bash")) {
-      if (!option_load_bool(option, &config->bash_escape)) {
-        goto out;
-      }
-    } else {
-      fprintf(stderr, "Invalid option '%s'\n", name);
-      goto out;
-    }
-    elem = list_elem_next(elem);
+  mapped = true;
+  struct loader loader = {
+    .config = config,
+    .skip = skip,
+    .skipped = false,
+  };
+  const struct config_handler handler = {
+    .accept = loader_accept,
+    .option = loader_option,
+    .ctx = &loader,
+  };
+  // Parsed values are copied into the arena, the file is not referred to
+  // once parsing is done
+  if (!parse_config(config->arena, file.data, file.data + file.length, &handler)) {
+    goto out;
   }
+  *complete = !loader.skipped;
   ret = true;
  out:
-  if (options) {
-    list_free(options, (elem_free_t)option_free);
-  }
-  if (data) {
-    free(data);
+  if (mapped) {
+    unmap_file(&file);
   }
-  if (handle) {
-    fclose(handle);
+  if (fd >= 0) {
+    close(fd);
   }
   return ret;
 }
 
-bool config_load(struct config *config) {
-  char *path = get_config_path();
+// The vectors of other grow into its arena, so the merged overrides are
+// collected into a vector of the arena that remains
+static struct vector *merge_overrides(struct arena *arena,
+                                      const struct vector *first,
+                                      const struct vector *second) {
+  struct vector *overrides = vector_create(arena, sizeof(struct override));
+  vector_extend(overrides, first);
+  vector_extend(overrides, second);
+  return overrides;
+}
+
+// Move fields set in other but not in config into config, so fields already
+// set in config take precedence. Overrides from other are applied before the
+// ones in config. The memory of other is taken over by config.
+void config_merge(struct config *config, struct config *other) {
+  arena_merge(config->arena, other->arena);
+  unsigned int fields = other->fields & ~config->fields;
+  // A theme selects both palettes, so it replaces the palettes of other
+  if (config->fields & CONFIG_FIELD_THEME) {
+    fields &= ~(CONFIG_FIELD_PATH_PALETTE | CONFIG_FIELD_SEPARATOR_PALETTE);
+  }
+  if (fields & CONFIG_FIELD_SEPARATOR) {
+    config->separator = other->separator;
+  }
+  if (fields & CONFIG_FIELD_PATH_PALETTE) {
+    config->path_palette = other->path_palette;
+  }
+  if (fields & CONFIG_FIELD_SEPARATOR_PALETTE) {
+    config->separator_palette = other->separator_palette;
+  }
+  if (fields & CONFIG_FIELD_THEME) {
+    config->theme = other->theme;
+  }
+  if (fields & CONFIG_FIELD_NEW_LINE) {
+    config->new_line = other->new_line;
+  }
+  if (fields & CONFIG_FIELD_BASH_ESCAPE) {
+    config->bash_escape = other->bash_escape;
+  }
+  if (fields & CONFIG_FIELD_COMPACT) {
+    config->compact = other->compact;
+  }
+  if (fields & CONFIG_FIELD_STRIP_LEADING) {
+    config->strip_leading = other->strip_leading;
+  }
+  if (fields & CONFIG_FIELD_PATH_INDEXER) {
+    config->path_indexer = other->path_indexer;
+  }
+  if (fields & CONFIG_FIELD_SEPARATOR_INDEXER) {
+    config->separator_indexer = other->separator_indexer;
+  }
+  config->path_overrides = merge_overrides(config->arena,
+                                           other->path_overrides,
+                                           config->path_overrides);
+  config->separator_overrides = merge_overrides(config->arena,
+                                                other->separator_overrides,
+                                                config->separator_overrides);
+  config->fields |= fields;
+}
+
+// Load the configuration file into a configuration of its own. Options for
+// fields in skip may be left out. Returns NULL if the configuration file
+// could not be loaded.
+struct config *config_load_file(unsigned int skip) {
+  struct config *file_config = config_create();
+  struct stat buf;
+  char *path = get_config_path(&buf);
   if (!path) {
-    return true;
+    return file_config;
+  }
+  if (!config_cache_load(file_config, path, &buf)) {
+    // Discard anything a partially valid cache file might have loaded
+    config_free(file_config);
+    file_config = config_create();
+    bool complete;
+    if (config_load_path(file_config, path, &buf, skip, &complete)) {
+      // Only cache configurations that do not depend on the command line
+      if (complete) {
+        config_cache_store(file_config, path, &buf);
+      }
+    } else {
+      config_free(file_config);
+      file_config = NULL;
+    }
   }
-  bool ret = config_load_path(config, path);
   free(path);
-  return ret;
+  return file_config;
 }
 
-size_t override_index(const struct override *override, size_t length) {
-  return MOD(override->raw_index, ((ssize_t)length));
+struct config *config_load_layer(unsigned int skip) {
+  struct config *file_config = config_create();
+  if (!config_snapshot_load(file_config)) {
+    config_free(file_config);
+    file_config = config_load_file(skip);
+  }
+  return file_config;
+}
+
+bool config_load(struct config *config) {
+  struct config *file_config = config_load_layer(config->fields);
+  if (!file_config) {
+    return false;
+  }
+  config_merge(config, file_config);
+  config_free(file_config);
+  return true;
+}
+
+char *config_snapshot(void) {
+  struct config *file_config = config_load_file(0);
+  if (!file_config) {
+    return NULL;
+  }
+  char *snapshot = config_snapshot_encode(file_config);
+  config_free(file_config);
+  return snapshot;
 }
 
-void override_free(struct override *override) {
-  free(override->style);
-  free(override);
+size_t override_index(const struct override *override, size_t length) {
+  return MOD(override->raw_index, ((ssize_t)length));
 }
 
 struct config *config_create(void) {
   struct config *config = check(malloc(sizeof(*config)));
-  config->path = NULL;
-  config->separator = check(strdup("/"));
+  config->arena = arena_create();
+  config->paths = NULL;
+  config->path_count = 0;
+  config->separator = arena_strdup(config->arena, "/");
   config->path_palette = NULL;
   config->separator_palette = NULL;
-  config->path_overrides = list_create();
-  config->separator_overrides = list_create();
+  config->theme = NULL;
+  config->path_overrides = vector_create(config->arena, sizeof(struct override));
+  config->separator_overrides = vector_create(config->arena, sizeof(struct override));
   config->new_line = true;
   config->bash_escape = false;
   config->compact = false;
   config->strip_leading = false;
   config->path_indexer = index_sequential;
   config->separator_indexer = index_sequential;
+  config->path_file = NULL;
+  config->pid = 0;
+  config->watch = false;
+  config->stream = false;
+  config->from_file = NULL;
+  config->input = false;
+  config->delimiter = '\n';
+  config->terminator = NULL;
+  config->jobs = 1;
+  config->max_latency = 0;
+  config->stats = false;
+  config->tree = false;
+  config->highlight_paths = false;
+  config->record_field = 0;
+  config->field_delimiter = FIELD_BLANKS;
+  config->ls_colors = false;
+  config->deadline = 0;
+  config->fields = 0;
   return config;
 }
 
@@ -263,6 +506,9 @@ const struct palette *config_path_palette(struct terminal *terminal,
   if (config->path_palette) {
     return config->path_palette;
   }
+  if (config->theme) {
+    return theme_path_palette(config->theme, terminal_color_count(terminal));
+  }
   if (terminal_color_count(terminal) >= 256) {
     return PATH_PALETTE_256;
   }
@@ -274,6 +520,9 @@ const struct palette *config_separator_palette(struct terminal *terminal,
   if (config->separator_palette) {
     return config->separator_palette;
   }
+  if (config->theme) {
+    return theme_separator_palette(config->theme, terminal_color_count(terminal));
+  }
   if (terminal_color_count(terminal) >= 256) {
     return SEPARATOR_PALETTE_256;
   }
@@ -281,17 +530,6 @@ const struct palette *config_separator_palette(struct terminal *terminal,
 }
 
 void config_free(struct config *config) {
-  if (config->separator) {
-    free(config->separator);
-  }
-  if (config->path_palette) {
-    palette_free(config->path_palette);
-  }
-  if (config->separator_palette) {
-    palette_free(config->separator_palette);
-  }
-  list_free(config->path_overrides, (elem_free_t)override_free);
-  list_free(config->separator_overrides, (elem_free_t)override_free);
+  arena_free(config->arena);
   free(config);
 }
-
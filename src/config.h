@@ -3,36 +3,89 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+#include "arena.h"
 #include "indexer.h"
 #include "terminal.h"
+#include "styles.h"
+#include "vector.h"
 
 struct override {
   ssize_t raw_index;
   struct style *style;
 };
 
+enum config_field {
+  CONFIG_FIELD_SEPARATOR = 1 << 0,
+  CONFIG_FIELD_PATH_PALETTE = 1 << 1,
+  CONFIG_FIELD_SEPARATOR_PALETTE = 1 << 2,
+  CONFIG_FIELD_NEW_LINE = 1 << 3,
+  CONFIG_FIELD_BASH_ESCAPE = 1 << 4,
+  CONFIG_FIELD_COMPACT = 1 << 5,
+  CONFIG_FIELD_STRIP_LEADING = 1 << 6,
+  CONFIG_FIELD_PATH_INDEXER = 1 << 7,
+  CONFIG_FIELD_SEPARATOR_INDEXER = 1 << 8,
+  CONFIG_FIELD_THEME = 1 << 9,
+};
+
+// Field delimiter of fields separated by runs of spaces and tabs
+enum {
+  FIELD_BLANKS = -1
+};
+
+enum {
+  CONFIG_WATCH_PATHS = 3
+};
+
+// Everything a configuration refers to is allocated from its arena
+
 struct config {
-  const char *path;
+  struct arena *arena;
+  char **paths; // Paths given as arguments
+  size_t path_count;
+  const char *path_file;
+  pid_t pid; // Zero if not set
+  bool watch;
+  bool stream; // Render paths read from standard input
+  const char *from_file; // File to read paths from, NULL if not set
+  bool input; // Arguments are files to read paths from
+  char delimiter; // Delimiter of paths read from standard input or a file
+  const char *terminator; // Written after each path, NULL for the delimiter
+  size_t jobs; // Threads rendering paths read from standard input or a file
+  uint64_t max_latency; // Nanoseconds output is held back, zero if unbounded
+  bool stats; // Report statistics on rendering paths read from input
+  bool tree; // Show paths read from input as a tree
+  bool highlight_paths; // Input is text with paths in it
+  size_t record_field; // Field of each record rendered, zero for all of it
+  int field_delimiter; // Byte separating fields, or FIELD_BLANKS
+  bool ls_colors; // Style the last component of paths by LS_COLORS
   char *separator;
   struct palette *path_palette;
   struct palette *separator_palette;
-  struct list *path_overrides;
-  struct list *separator_overrides;
+  const struct theme *theme; // NULL if not set
+  struct vector *path_overrides; // Of struct override
+  struct vector *separator_overrides; // Of struct override
   bool new_line;
   bool bash_escape;
   bool compact;
   bool strip_leading;
   indexer_t path_indexer;
   indexer_t separator_indexer;
+  uint64_t deadline; // Nanoseconds, zero if there is no deadline
+  unsigned int fields; // Fields explicitly set, see enum config_field
 };
 
 size_t override_index(const struct override *override, size_t length);
-void override_free(struct override *override);
 
 struct config *config_create(void);
+struct config *config_load_file(unsigned int skip);
+struct config *config_load_layer(unsigned int skip);
+void config_merge(struct config *config, struct config *other);
 bool config_load(struct config *config);
+char *config_snapshot(void);
+size_t config_watch_paths(char *paths[CONFIG_WATCH_PATHS]);
 const struct palette *config_path_palette(struct terminal *terminal, const struct config *config);
 const struct palette *config_separator_palette(struct terminal *terminal, const struct config *config);
 void config_free(struct config *config);
@@ -0,0 +1,494 @@
+#include "build.h"
+
+#include "config_cache.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "vector.h"
+#include "styles.h"
+#include "indexer.h"
+#include "utils.h"
+
+// Compiled configuration cache. The cache file consists of a header
+// identifying the source configuration file followed by the serialized
+// configuration. The encoding uses native byte order since the cache never
+// leaves the machine it was written on.
+
+#define CACHE_MAGIC "RBPC"
+
+enum {
+  CACHE_VERSION = 2
+};
+
+struct cache_header {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_mtime_sec;
+  int64_t source_mtime_nsec;
+  uint32_t source_path_length;
+  uint32_t payload_length;
+};
+
+// Serialization
+
+static void put_u8(struct bytes *out, uint8_t value) {
+  bytes_append(out, &value, sizeof(value));
+}
+
+static void put_u32(struct bytes *out, uint32_t value) {
+  bytes_append(out, &value, sizeof(value));
+}
+
+static void put_i64(struct bytes *out, int64_t value) {
+  bytes_append(out, &value, sizeof(value));
+}
+
+static void put_string(struct bytes *out, const char *str) {
+  size_t length = strlen(str);
+  put_u32(out, length);
+  bytes_append(out, str, length);
+}
+
+static void put_style(struct bytes *out, const struct style *style) {
+  put_u8(out, style->fg.state);
+  put_u8(out, style->fg.value);
+  put_u8(out, style->bg.state);
+  put_u8(out, style->bg.value);
+  put_u8(out, style->bold.state);
+  put_u8(out, style->bold.value);
+  put_u8(out, style->dim.state);
+  put_u8(out, style->dim.value);
+  put_u8(out, style->underlined.state);
+  put_u8(out, style->underlined.value);
+  put_u8(out, style->blink.state);
+  put_u8(out, style->blink.value);
+}
+
+static void put_palette(struct bytes *out, const struct palette *palette) {
+  size_t size = palette_size(palette);
+  put_u32(out, size);
+  for (size_t i = 0; i < size; i++) {
+    put_style(out, palette_get(palette, i));
+  }
+}
+
+static void put_overrides(struct bytes *out, const struct vector *overrides) {
+  size_t count = vector_size(overrides);
+  put_u32(out, count);
+  for (size_t i = 0; i < count; i++) {
+    const struct override *override = vector_get(overrides, i);
+    put_i64(out, override->raw_index);
+    put_style(out, override->style);
+  }
+}
+
+void config_serialize(const struct config *config, struct bytes *out) {
+  put_u32(out, config->fields);
+  put_u8(out, config->new_line);
+  put_u8(out, config->bash_escape);
+  put_u8(out, config->compact);
+  put_u8(out, config->strip_leading);
+  if (config->fields & CONFIG_FIELD_SEPARATOR) {
+    put_string(out, config->separator);
+  }
+  if (config->fields & CONFIG_FIELD_PATH_PALETTE) {
+    put_palette(out, config->path_palette);
+  }
+  if (config->fields & CONFIG_FIELD_SEPARATOR_PALETTE) {
+    put_palette(out, config->separator_palette);
+  }
+  if (config->fields & CONFIG_FIELD_THEME) {
+    put_string(out, theme_name(config->theme));
+  }
+  if (config->fields & CONFIG_FIELD_PATH_INDEXER) {
+    put_string(out, indexer_name(config->path_indexer));
+  }
+  if (config->fields & CONFIG_FIELD_SEPARATOR_INDEXER) {
+    put_string(out, indexer_name(config->separator_indexer));
+  }
+  put_overrides(out, config->path_overrides);
+  put_overrides(out, config->separator_overrides);
+}
+
+// Deserialization
+
+struct reader {
+  struct arena *arena; // Allocations for the configuration being read
+  const char *pos;
+  const char *end;
+};
+
+static bool get_bytes(struct reader *reader, void *data, size_t length) {
+  if ((size_t)(reader->end - reader->pos) < length) {
+    return false;
+  }
+  memcpy(data, reader->pos, length);
+  reader->pos += length;
+  return true;
+}
+
+static bool get_u8(struct reader *reader, uint8_t *value) {
+  return get_bytes(reader, value, sizeof(*value));
+}
+
+static bool get_u32(struct reader *reader, uint32_t *value) {
+  return get_bytes(reader, value, sizeof(*value));
+}
+
+static bool get_i64(struct reader *reader, int64_t *value) {
+  return get_bytes(reader, value, sizeof(*value));
+}
+
+static bool get_bool(struct reader *reader, bool *value) {
+  uint8_t byte;
+  if (!get_u8(reader, &byte) || byte > 1) {
+    return false;
+  }
+  *value = byte;
+  return true;
+}
+
+static bool get_string(struct reader *reader, char **str) {
+  uint32_t length;
+  if (!get_u32(reader, &length)) {
+    return false;
+  }
+  if ((size_t)(reader->end - reader->pos) < length
+      || memchr(reader->pos, '\0', length)) {
+    return false;
+  }
+  *str = arena_strndup(reader->arena, reader->pos, length);
+  reader->pos += length;
+  return true;
+}
+
+static bool get_method(struct reader *reader, indexer_t *indexer) {
+  char *name;
+  if (!get_string(reader, &name)) {
+    return false;
+  }
+  indexer_t indexer_ = get_indexer(name);
+  if (!indexer_) {
+    return false;
+  }
+  *indexer = indexer_;
+  return true;
+}
+
+static bool get_theme_name(struct reader *reader, const struct theme **theme) {
+  char *name;
+  if (!get_string(reader, &name)) {
+    return false;
+  }
+  const struct theme *theme_ = get_theme(name);
+  if (!theme_) {
+    return false;
+  }
+  *theme = theme_;
+  return true;
+}
+
+static bool get_state(struct reader *reader, enum attr_state *state) {
+  uint8_t byte;
+  if (!get_u8(reader, &byte) || byte > ATTR_STATE_REVERTED) {
+    return false;
+  }
+  *state = byte;
+  return true;
+}
+
+static bool get_color_attr(struct reader *reader, struct color_attr *attr) {
+  return get_state(reader, &attr->state) && get_u8(reader, &attr->value);
+}
+
+static bool get_bool_attr(struct reader *reader, struct bool_attr *attr) {
+  return get_state(reader, &attr->state) && get_bool(reader, &attr->value);
+}
+
+static bool get_style(struct reader *reader, struct style *style) {
+  return get_color_attr(reader, &style->fg)
+    && get_color_attr(reader, &style->bg)
+    && get_bool_attr(reader, &style->bold)
+    && get_bool_attr(reader, &style->dim)
+    && get_bool_attr(reader, &style->underlined)
+    && get_bool_attr(reader, &style->blink);
+}
+
+static bool get_palette(struct reader *reader, struct palette **palette) {
+  uint32_t size;
+  if (!get_u32(reader, &size) || size == 0) {
+    return false;
+  }
+  struct palette *palette_ = palette_create(reader->arena);
+  for (uint32_t i = 0; i < size; i++) {
+    if (!get_style(reader, palette_add(palette_))) {
+      return false;
+    }
+  }
+  *palette = palette_;
+  return true;
+}
+
+static bool get_overrides(struct reader *reader, struct vector *overrides) {
+  uint32_t count;
+  if (!get_u32(reader, &count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    int64_t index;
+    if (!get_i64(reader, &index)) {
+      return false;
+    }
+    struct style *style = arena_alloc(reader->arena, sizeof(*style));
+    if (!get_style(reader, style)) {
+      return false;
+    }
+    struct override *override = vector_push(overrides);
+    override->raw_index = index;
+    override->style = style;
+  }
+  return true;
+}
+
+bool config_deserialize(struct config *config, const char *pos, const char *end) {
+  struct reader reader = { .arena = config->arena, .pos = pos, .end = end };
+  uint32_t fields;
+  if (!get_u32(&reader, &fields)
+      || !get_bool(&reader, &config->new_line)
+      || !get_bool(&reader, &config->bash_escape)
+      || !get_bool(&reader, &config->compact)
+      || !get_bool(&reader, &config->strip_leading)) {
+    return false;
+  }
+  if (fields & CONFIG_FIELD_SEPARATOR) {
+    if (!get_string(&reader, &config->separator)) {
+      return false;
+    }
+  }
+  if ((fields & CONFIG_FIELD_PATH_PALETTE)
+      && !get_palette(&reader, &config->path_palette)) {
+    return false;
+  }
+  if ((fields & CONFIG_FIELD_SEPARATOR_PALETTE)
+      && !get_palette(&reader, &config->separator_palette)) {
+    return false;
+  }
+  if ((fields & CONFIG_FIELD_THEME)
+      && !get_theme_name(&reader, &config->theme)) {
+    return false;
+  }
+  if ((fields & CONFIG_FIELD_PATH_INDEXER)
+      && !get_method(&reader, &config->path_indexer)) {
+    return false;
+  }
+  if ((fields & CONFIG_FIELD_SEPARATOR_INDEXER)
+      && !get_method(&reader, &config->separator_indexer)) {
+    return false;
+  }
+  if (!get_overrides(&reader, config->path_overrides)
+      || !get_overrides(&reader, config->separator_overrides)) {
+    return false;
+  }
+  if (reader.pos != reader.end) {
+    return false;
+  }
+  config->fields |= fields;
+  return true;
+}
+
+// Cache files
+
+static char *get_cache_name(const char *source) {
+  uint32_t hash = 5381;
+  for (const char *c = source; *c; c++) {
+    hash = ((hash << 5) + hash) + (uint8_t)*c;
+  }
+  return check_asprintf("config-%08x.cache", hash);
+}
+
+static void fill_header(struct cache_header *header,
+                        const char *source,
+                        const struct stat *buf,
+                        size_t payload_length) {
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+  header->version = CACHE_VERSION;
+  header->source_size = buf->st_size;
+  header->source_mtime_sec = buf->st_mtim.tv_sec;
+  header->source_mtime_nsec = buf->st_mtim.tv_nsec;
+  header->source_path_length = strlen(source);
+  header->payload_length = payload_length;
+}
+
+bool config_cache_load(struct config *config,
+                       const char *source,
+                       const struct stat *buf) {
+  bool ret = false;
+  const char *data;
+  size_t length;
+  char *name = get_cache_name(source);
+  bool mapped = cache_map(name, &data, &length);
+  free(name);
+  if (!mapped) {
+    return false;
+  }
+  if (length < sizeof(struct cache_header)) {
+    goto out;
+  }
+  struct cache_header expected;
+  struct cache_header header;
+  memcpy(&header, data, sizeof(header));
+  fill_header(&expected, source, buf, header.payload_length);
+  const char *source_path = data + sizeof(header);
+  const char *payload = source_path + header.source_path_length;
+  if (!memcmp(&header, &expected, sizeof(header))
+      && length == sizeof(header) + header.source_path_length + header.payload_length
+      && !memcmp(source_path, source, header.source_path_length)) {
+    ret = config_deserialize(config, payload, payload + header.payload_length);
+  }
+ out:
+  cache_unmap(data, length);
+  return ret;
+}
+
+void config_cache_store(const struct config *config,
+                        const char *source,
+                        const struct stat *buf) {
+  struct bytes *payload = bytes_create(NULL);
+  config_serialize(config, payload);
+  struct cache_header header;
+  fill_header(&header, source, buf, bytes_size(payload));
+  struct bytes *contents = bytes_create(NULL);
+  bytes_append(contents, &header, sizeof(header));
+  bytes_append(contents, source, header.source_path_length);
+  bytes_append(contents, bytes_data(payload), bytes_size(payload));
+  char *name = get_cache_name(source);
+  cache_store(name, bytes_data(contents), bytes_size(contents));
+  free(name);
+  bytes_free(contents);
+  bytes_free(payload);
+}
+
+// Environment snapshots. A snapshot is the serialized configuration prefixed
+// with a fingerprint of the environment the configuration file was discovered
+// in, encoded in Base64 so that it can be passed in an environment variable.
+
+static const char BASE64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char *FINGERPRINT_VARIABLES[] = {
+  "HOME",
+  "XDG_CONFIG_HOME",
+  "XDG_CONFIG_DIRS",
+};
+
+static uint64_t fingerprint_update(uint64_t hash, const char *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+static uint64_t snapshot_fingerprint(void) {
+  uint64_t hash = UINT64_C(0xcbf29ce484222325);
+  uint32_t version = CACHE_VERSION;
+  hash = fingerprint_update(hash, (const char *)&version, sizeof(version));
+  for (size_t i = 0; i < ARRAY_SIZE(FINGERPRINT_VARIABLES); i++) {
+    const char *value = get_env(FINGERPRINT_VARIABLES[i]);
+    if (value) {
+      hash = fingerprint_update(hash, value, strlen(value) + 1);
+    } else {
+      hash = fingerprint_update(hash, "\xff", 1);
+    }
+  }
+  return hash;
+}
+
+static char *base64_encode(const char *data, size_t length) {
+  char *result = check(malloc((length + 2) / 3 * 4 + 1));
+  const uint8_t *in = (const uint8_t *)data;
+  char *out = result;
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t group = (uint32_t)in[i] << 16;
+    if (i + 1 < length) {
+      group |= (uint32_t)in[i + 1] << 8;
+    }
+    if (i + 2 < length) {
+      group |= in[i + 2];
+    }
+    *out++ = BASE64[(group >> 18) & 0x3f];
+    *out++ = BASE64[(group >> 12) & 0x3f];
+    *out++ = i + 1 < length ? BASE64[(group >> 6) & 0x3f] : '=';
+    *out++ = i + 2 < length ? BASE64[group & 0x3f] : '=';
+  }
+  *out = '\0';
+  return result;
+}
+
+static int base64_value(char c) {
+  const char *pos = c ? strchr(BASE64, c) : NULL;
+  return pos ? pos - BASE64 : -1;
+}
+
+static bool base64_decode(const char *str, struct bytes *out) {
+  size_t length = strlen(str);
+  if (length % 4 != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i += 4) {
+    bool last = i + 4 == length;
+    int values[4];
+    size_t padding = 0;
+    for (size_t j = 0; j < 4; j++) {
+      if (last && j >= 2 && str[i + j] == '=') {
+        values[j] = 0;
+        padding++;
+      } else if (padding || (values[j] = base64_value(str[i + j])) < 0) {
+        return false;
+      }
+    }
+    uint32_t group = (uint32_t)values[0] << 18 | (uint32_t)values[1] << 12
+      | (uint32_t)values[2] << 6 | (uint32_t)values[3];
+    char decoded[3] = { group >> 16, group >> 8, group };
+    bytes_append(out, decoded, 3 - padding);
+  }
+  return true;
+}
+
+char *config_snapshot_encode(const struct config *config) {
+  struct bytes *blob = bytes_create(NULL);
+  uint64_t fingerprint = snapshot_fingerprint();
+  bytes_append(blob, &fingerprint, sizeof(fingerprint));
+  config_serialize(config, blob);
+  char *result = base64_encode(bytes_data(blob), bytes_size(blob));
+  bytes_free(blob);
+  return result;
+}
+
+bool config_snapshot_load(struct config *config) {
+  const char *snapshot = get_env(SNAPSHOT_VARIABLE);
+  if (!snapshot) {
+    return false;
+  }
+  bool ret = false;
+  struct bytes *blob = bytes_create(NULL);
+  if (!base64_decode(snapshot, blob) || bytes_size(blob) < sizeof(uint64_t)) {
+    goto out;
+  }
+  uint64_t fingerprint;
+  memcpy(&fingerprint, bytes_data(blob), sizeof(fingerprint));
+  if (fingerprint != snapshot_fingerprint()) {
+    goto out;
+  }
+  ret = config_deserialize(config,
+                           bytes_data(blob) + sizeof(fingerprint),
+                           bytes_data(blob) + bytes_size(blob));
+ out:
+  bytes_free(blob);
+  return ret;
+}
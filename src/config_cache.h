@@ -0,0 +1,21 @@
+#ifndef CONFIG_CACHE_H
+#define CONFIG_CACHE_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "bytes.h"
+#include "config.h"
+
+void config_serialize(const struct config *config, struct bytes *out);
+bool config_deserialize(struct config *config, const char *pos, const char *end);
+
+bool config_cache_load(struct config *config, const char *source, const struct stat *buf);
+void config_cache_store(const struct config *config, const char *source, const struct stat *buf);
+
+#define SNAPSHOT_VARIABLE "RAINBOWPATH_SNAPSHOT"
+
+char *config_snapshot_encode(const struct config *config);
+bool config_snapshot_load(struct config *config);
+
+#endif
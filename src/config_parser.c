@@ -1,15 +1,25 @@
 #include "config_parser.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "bytes.h"
 #include "utils.h"
 #include "parser_common.h"
+#include "keywords.h"
+
+// Options are handed to the handler as soon as they have been parsed and
+// only live until the handler returns. Option names refer to the parsed
+// input while string values, which may contain escape sequences, are copied
+// into the arena.
 
 struct option {
-  char *name;
+  struct string_view name;
+  size_t line;
+  size_t name_column;
+  size_t column; // Of the value
   bool has_index;
   ssize_t index;
   enum option_kind kind;
@@ -19,35 +29,20 @@ struct option {
   };
 };
 
-struct option *option_create_bool(char *name, bool b) {
-  struct option *option = check(malloc(sizeof(*option)));
-  option->name = name;
-  option->has_index = false;
-  option->kind = OPTION_KIND_BOOL;
-  option->bool_value = b;
-  return option;
-}
-
-struct option *option_create_string(char *name, char *string) {
-  struct option *option = check(malloc(sizeof(*option)));
-  option->name = name;
-  option->has_index = false;
-  option->kind = OPTION_KIND_STRING;
-  option->string_value = string;
-  return option;
+const struct string_view *option_name(const struct option *option) {
+  return &option->name;
 }
 
-const char *option_name(const struct option *option) {
-  return option->name;
+size_t option_line(const struct option *option) {
+  return option->line;
 }
 
-void option_set_index(struct option *option, ssize_t index) {
-  option->has_index = true;
-  option->index = index;
+size_t option_name_column(const struct option *option) {
+  return option->name_column;
 }
 
-void option_unset_index(struct option *option) {
-  option->has_index = false;
+size_t option_column(const struct option *option) {
+  return option->column;
 }
 
 bool option_has_index(const struct option *option) {
@@ -80,15 +75,23 @@ char *option_take_string_value(struct option *option) {
   return ret;
 }
 
-void option_free(struct option *option) {
-  free(option->name);
-  if (option->kind == OPTION_KIND_STRING && option->string_value) {
-    free(option->string_value);
-  }
-  free(option);
+// Config Parser
+
+struct parser {
+  struct arena *arena;
+  const struct config_handler *handler;
+  const char *line; // Start of the line being parsed
+  size_t line_number;
+};
+
+static size_t column(const struct parser *parser, const char *pos) {
+  return pos - parser->line + 1;
 }
 
-// Config Parser
+static void error_at(const struct parser *parser, const char *pos, const char *message) {
+  fprintf(stderr, "Line %zu, column %zu: %s\n",
+          parser->line_number, column(parser, pos), message);
+}
 
 static const char *skip_line(const char *pos, const char *end) {
   while (!at_end(pos, end) && *pos != '\n') {
@@ -127,35 +130,36 @@ static bool map_escape(char c, char *ret) {
   return true;
 }
 
-static const char *parse_string(const char *pos, const char *end, char **str) {
-  pos = parse_char(pos, end, '"');
-  if (!pos) {
-    parse_error("Expected string value");
+static const char *parse_string(const struct parser *parser, const char *pos, const char *end, char **str) {
+  pos = skip_whitespace(pos, end);
+  if (at_end(pos, end) || *pos != '"') {
+    error_at(parser, pos, "Expected string value");
     return NULL;
   }
-  struct bytes *str_ = bytes_create();
+  pos++;
+  struct bytes *str_ = bytes_create(parser->arena);
   while (true) {
     if (at_end(pos, end)) {
-      parse_error("Unterminated string");
-      goto error;
+      error_at(parser, pos, "Unterminated string");
+      return NULL;
     }
     switch (*pos) {
     case '\\':
       pos++;
       if (at_end(pos, end)) {
-        parse_error("Unterminated escape sequence");
-        goto error;
+        error_at(parser, pos, "Unterminated escape sequence");
+        return NULL;
       }
       char escaped;
       if (!map_escape(*pos, &escaped)) {
-        parse_error("Invalid escape sequence");
-        goto error;
+        error_at(parser, pos, "Invalid escape sequence");
+        return NULL;
       }
       bytes_append_char(str_, escaped);
       break;
     case '\0':
-      parse_error("Unexpected null byte");
-      goto error;
+      error_at(parser, pos, "Unexpected null byte");
+      return NULL;
     case '"':
       pos++;
       goto out;
@@ -169,141 +173,129 @@ static const char *parse_string(const char *pos, const char *end, char **str) {
   bytes_append_char(str_, '\0');
   *str = bytes_take(str_);
   return pos;
- error:
-  bytes_free(str_);
-  return NULL;
 }
 
-static const char *parse_bool(const char *pos, const char *end, bool *b) {
-  char *token;
+static const char *parse_bool(const struct parser *parser, const char *pos, const char *end, bool *b) {
+  struct string_view token;
+  pos = skip_whitespace(pos, end);
+  const char *start = pos;
   pos = parse_token(pos, end, &token);
   if (!pos) {
+    error_at(parser, start, "Expected boolean value");
     return NULL;
   }
-  if (!strcmp(token, "true")) {
+  switch (keyword_lookup(token.data, token.length)) {
+  case KEYWORD_TRUE:
     *b = true;
-  } else if (!strcmp(token, "false")) {
+    break;
+  case KEYWORD_FALSE:
     *b = false;
-  } else {
-    parse_error("Expected boolean value");
-    pos = NULL;
+    break;
+  default:
+    error_at(parser, start, "Expected boolean value");
+    return NULL;
   }
-  free(token);
   return pos;
 }
 
-static const char *parse_index(const char *pos, const char *end, ssize_t *i) {
+static const char *parse_index(const struct parser *parser, const char *pos, const char *end, ssize_t *i) {
   pos = parse_char(pos, end, '[');
+  assert(pos);
+  pos = skip_whitespace(pos, end);
+  const char *start = pos;
+  struct string_view token;
+  pos = parse_token(pos, end, &token);
   if (!pos) {
-    parse_error("Expected '['");
+    error_at(parser, start, "Expected index");
     return NULL;
   }
-  char *token;
-  pos = parse_token(pos, end, &token);
-  if (!pos) {
-    parse_error("Expected index");
+  if (!view_to_ssize(&token, i)) {
+    error_at(parser, start, "Invalid index");
     return NULL;
   }
-  ssize_t i_;
-  if (!parse_ssize(token, &i_)) {
-    parse_error("Invalid index");
-    pos = NULL;
-    goto out;
+  const char *close = parse_char(pos, end, ']');
+  if (!close) {
+    error_at(parser, skip_whitespace(pos, end), "Expected ']'");
+    return NULL;
   }
-  pos = parse_char(pos, end, ']');
-  if (!pos) {
-    parse_error("Expected ']'");
-    goto out;
+  return close;
+}
+
+static const char *parse_value(const struct parser *parser, const char *pos, const char *end, struct option *option) {
+  const char *start = skip_whitespace(pos, end);
+  option->column = column(parser, start);
+  if (parse_char(start, end, '"')) {
+    option->kind = OPTION_KIND_STRING;
+    return parse_string(parser, start, end, &option->string_value);
+  } else if (parse_char(start, end, 't') || parse_char(start, end, 'f')) {
+    option->kind = OPTION_KIND_BOOL;
+    return parse_bool(parser, start, end, &option->bool_value);
   }
-  *i = i_;
- out:
-  free(token);
-  return pos;
+  error_at(parser, start, "Invalid value");
+  return NULL;
 }
 
-static const char *parse_option_assignment(const char *pos, const char *end, struct option **option) {
-  const char *endl = skip_line(pos, end);
-  char *name = NULL;
-  struct option *option_ = NULL;
-  pos = parse_token(pos, endl, &name);
+// Parse a single line holding an option assignment and hand the option to
+// the handler. Values of options the handler does not accept are skipped
+// without being parsed.
+static bool parse_option_assignment(struct parser *parser, const char *pos, const char *endl) {
+  struct option option = { .line = parser->line_number };
+  const char *start = skip_whitespace(pos, endl);
+  pos = parse_token(start, endl, &option.name);
   if (!pos) {
-    parse_error("Expected option");
-    goto error;
+    error_at(parser, start, "Expected option");
+    return false;
   }
-  bool has_index = false;
-  ssize_t index;
+  option.name_column = column(parser, start);
   if (parse_char(pos, endl, '[')) {
-    pos = parse_index(pos, endl, &index);
+    pos = parse_index(parser, pos, endl, &option.index);
     if (!pos) {
-      goto error;
+      return false;
     }
-    has_index = true;
+    option.has_index = true;
   }
-  pos = parse_char(pos, endl, '=');
-  if (!pos) {
-    parse_error("Expected '='");
-    goto error;
+  const char *equals = parse_char(pos, endl, '=');
+  if (!equals) {
+    error_at(parser, skip_whitespace(pos, endl), "Expected '='");
+    return false;
   }
-  if (parse_char(pos, endl, '"')) {
-    char *str;
-    pos = parse_string(pos, endl, &str);
-    if (!pos) {
-      goto error;
-    }
-    option_ = option_create_string(name, str);
-  } else if (parse_char(pos, endl, 't') || parse_char(pos, endl, 'f')) {
-    bool b;
-    pos = parse_bool(pos, endl, &b);
-    if (!pos) {
-      goto error;
-    }
-    option_ = option_create_bool(name, b);
-  } else {
-    parse_error("Invalid value");
-    goto error;
+  const struct config_handler *handler = parser->handler;
+  if (!handler->accept(handler->ctx, &option.name)) {
+    return true;
+  }
+  pos = parse_value(parser, equals, endl, &option);
+  if (!pos) {
+    return false;
   }
-  name = NULL;
   pos = skip_whitespace(pos, endl);
   if (!at_end(pos, endl)) {
-    parse_error("Expected end of line");
-    goto error;
-  }
-  if (has_index) {
-    option_set_index(option_, index);
-  }
-  *option = option_;
-  return pos;
- error:
-  if (name) {
-    free(name);
-  }
-  if (option_) {
-    option_free(option_);
+    error_at(parser, pos, "Expected end of line");
+    return false;
   }
-  return NULL;
+  return handler->option(handler->ctx, &option);
 }
 
-const char *parse_config(const char *pos, const char *end, struct list **options) {
-  struct list *options_ = list_create();
+const char *parse_config(struct arena *arena,
+                         const char *pos,
+                         const char *end,
+                         const struct config_handler *handler) {
+  struct parser parser = {
+    .arena = arena,
+    .handler = handler,
+    .line = pos,
+    .line_number = 1,
+  };
   while (!at_end(pos, end)) {
-    pos = skip_whitespace(pos, end);
-    if (at_end(pos, end)) {
-      break;
-    }
-    if (parse_char(pos, end, '#')) {
-      pos = skip_line(pos, end);
-      continue;
+    const char *next = skip_line(pos, end);
+    const char *endl = next > pos && next[-1] == '\n' ? next - 1 : next;
+    parser.line = pos;
+    pos = skip_whitespace(pos, endl);
+    if (!at_end(pos, endl) && *pos != '#'
+        && !parse_option_assignment(&parser, pos, endl)) {
+      return NULL;
     }
-    struct option *option;
-    pos = parse_option_assignment(pos, end, &option);
-    if (!pos) {
-      goto error;
-    }
-    list_append(options_, option);
+    pos = next;
+    parser.line_number++;
   }
-  *options = options_;
   return pos;
- error:
-  list_free(options_, (elem_free_t)option_free);
-  return NULL;
 }
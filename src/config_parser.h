@@ -4,7 +4,8 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
-#include "list.h"
+#include "arena.h"
+#include "parser_common.h"
 
 enum option_kind {
   OPTION_KIND_BOOL,
@@ -13,19 +14,31 @@ enum option_kind {
 
 struct option;
 
-struct option *option_create_bool(char *name, bool b);
-struct option *option_create_string(char *name, char *string);
-const char *option_name(const struct option *option);
-void option_set_index(struct option *option, ssize_t index);
-void option_unset_index(struct option *option);
+const struct string_view *option_name(const struct option *option);
+size_t option_line(const struct option *option);
+size_t option_name_column(const struct option *option);
+size_t option_column(const struct option *option);
 bool option_has_index(const struct option *option);
 ssize_t option_index(const struct option *option);
 enum option_kind option_kind(const struct option *option);
 bool option_bool_value(const struct option *option);
 const char *option_string_value(const struct option *option);
 char *option_take_string_value(struct option *option);
-void option_free(struct option *option);
 
-const char *parse_config(const char *pos, const char *end, struct list **options);
+// Callbacks invoked while a configuration file is being parsed
+struct config_handler {
+  // Decide whether the value of the named option should be parsed. Values
+  // of options that are not accepted are skipped without validation.
+  bool (*accept)(void *ctx, const struct string_view *name);
+  // Apply an option. The option is only valid during the call. Returning
+  // false stops parsing.
+  bool (*option)(void *ctx, struct option *option);
+  void *ctx;
+};
+
+const char *parse_config(struct arena *arena,
+                         const char *pos,
+                         const char *end,
+                         const struct config_handler *handler);
 
 #endif
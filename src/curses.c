@@ -1,6 +1,9 @@
 #include "terminal.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <curses.h>
 #include <term.h>
@@ -8,6 +11,7 @@
 #include "utils.h"
 
 struct terminal {
+  bool fallback; // Styles are written as ANSI escape codes without terminfo
   int color_count;
   const char *fg;
   const char *bg;
@@ -41,6 +45,7 @@ struct terminal *terminal_create(void) {
   }
 
   struct terminal *terminal = check(malloc(sizeof(*terminal)));
+  terminal->fallback = false;
 
   if ((int_value = tigetnum("colors")) < 0) {
     goto error;
@@ -89,38 +94,83 @@ struct terminal *terminal_create(void) {
   return NULL;
 }
 
+struct terminal *terminal_create_fallback(void) {
+  struct terminal *terminal = check(malloc(sizeof(*terminal)));
+  const char *term = get_env("TERM");
+  terminal->fallback = true;
+  terminal->color_count = term && strstr(term, "256color") ? 256 : 8;
+  terminal->fg = "\e[38;5;%" PRIu8 "m";
+  terminal->bg = "\e[48;5;%" PRIu8 "m";
+  terminal->bold = "\e[1m";
+  terminal->dim = "\e[2m";
+  terminal->underlined = "\e[4m";
+  terminal->blink = "\e[5m";
+  terminal->reset = "\e[0m";
+  return terminal;
+}
+
+// tputs hands the output over one character at a time without a context
+static struct bytes *output;
+
+static int put_char(int c) {
+  bytes_append_char(output, c);
+  return c;
+}
+
+static void put(struct terminal *terminal, struct bytes *out, const char *str) {
+  if (terminal->fallback) {
+    bytes_append(out, str, strlen(str));
+  } else {
+    output = out;
+    tputs(str, 1, put_char);
+  }
+}
+
+static void put_color(struct terminal *terminal,
+                      struct bytes *out,
+                      const char *cap,
+                      uint8_t color) {
+  if (terminal->fallback) {
+    char sequence[32];
+    int length = snprintf(sequence, sizeof(sequence), cap, color);
+    if (length > 0 && (size_t)length < sizeof(sequence)) {
+      bytes_append(out, sequence, length);
+    }
+    return;
+  }
+  put(terminal, out, tiparm(cap, color));
+}
+
 int terminal_color_count(struct terminal *terminal) {
   return terminal->color_count;
 }
 
-void terminal_fg(struct terminal *terminal, uint8_t color) {
-  char *result = tiparm(terminal->fg, color);
-  putp(result);
+void terminal_fg(struct terminal *terminal, struct bytes *out, uint8_t color) {
+  put_color(terminal, out, terminal->fg, color);
 }
 
-void terminal_bg(struct terminal *terminal, uint8_t color) {
-  char *result = tiparm(terminal->bg, color);
-  putp(result);
+void terminal_bg(struct terminal *terminal, struct bytes *out, uint8_t color) {
+  put_color(terminal, out, terminal->bg, color);
 }
 
-void terminal_bold(struct terminal *terminal) {
-  putp(terminal->bold);
+void terminal_bold(struct terminal *terminal, struct bytes *out) {
+  put(terminal, out, terminal->bold);
 }
 
-void terminal_dim(struct terminal *terminal) {
-  putp(terminal->dim);
+void terminal_dim(struct terminal *terminal, struct bytes *out) {
+  put(terminal, out, terminal->dim);
 }
 
-void terminal_underlined(struct terminal *terminal) {
-  putp(terminal->underlined);
+void terminal_underlined(struct terminal *terminal, struct bytes *out) {
+  put(terminal, out, terminal->underlined);
 }
 
-void terminal_blink(struct terminal *terminal) {
-  putp(terminal->blink);
+void terminal_blink(struct terminal *terminal, struct bytes *out) {
+  put(terminal, out, terminal->blink);
 }
 
-void terminal_reset_style(struct terminal *terminal) {
-  putp(terminal->reset);
+void terminal_reset_style(struct terminal *terminal, struct bytes *out) {
+  put(terminal, out, terminal->reset);
 }
 
 void terminal_free(struct terminal *terminal) {
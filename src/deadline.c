@@ -0,0 +1,116 @@
+#include "deadline.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "utils.h"
+
+// Work that might block on the file system is run on a thread of its own
+// while the caller waits for it until the deadline expires. Abandoned work
+// keeps running in the background and discards its result once it finishes.
+// The thread is terminated with the rest of the process on exit.
+
+struct job {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  deadline_fn_t fn;
+  void *arg;
+  deadline_discard_t discard;
+  void *result;
+  bool done;
+  bool abandoned;
+};
+
+enum {
+  NSEC_PER_SEC = 1000000000
+};
+
+void deadline_start(struct deadline *deadline, uint64_t budget_ns) {
+  deadline->enabled = budget_ns > 0;
+  if (!deadline->enabled) {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &deadline->expires);
+  uint64_t nsec = deadline->expires.tv_nsec + budget_ns;
+  deadline->expires.tv_sec += nsec / NSEC_PER_SEC;
+  deadline->expires.tv_nsec = nsec % NSEC_PER_SEC;
+}
+
+static void job_free(struct job *job) {
+  pthread_cond_destroy(&job->cond);
+  pthread_mutex_destroy(&job->mutex);
+  free(job);
+}
+
+static void *job_main(void *job_) {
+  struct job *job = job_;
+  void *result = job->fn(job->arg);
+  pthread_mutex_lock(&job->mutex);
+  bool abandoned = job->abandoned;
+  job->result = result;
+  job->done = true;
+  pthread_cond_signal(&job->cond);
+  pthread_mutex_unlock(&job->mutex);
+  if (abandoned) {
+    if (result && job->discard) {
+      job->discard(result);
+    }
+    job_free(job);
+  }
+  return NULL;
+}
+
+static struct job *job_create(deadline_fn_t fn, void *arg, deadline_discard_t discard) {
+  struct job *job = check(calloc(1, sizeof(*job)));
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&job->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&job->mutex, NULL);
+  job->fn = fn;
+  job->arg = arg;
+  job->discard = discard;
+  return job;
+}
+
+bool deadline_run(const struct deadline *deadline,
+                  deadline_fn_t fn,
+                  void *arg,
+                  deadline_discard_t discard,
+                  void **result) {
+  if (!deadline->enabled) {
+    *result = fn(arg);
+    return true;
+  }
+  struct job *job = job_create(fn, arg, discard);
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int error = pthread_create(&thread, &attr, job_main, job);
+  pthread_attr_destroy(&attr);
+  if (error) {
+    job_free(job);
+    *result = fn(arg);
+    return true;
+  }
+  pthread_mutex_lock(&job->mutex);
+  while (!job->done) {
+    if (pthread_cond_timedwait(&job->cond, &job->mutex, &deadline->expires) == ETIMEDOUT) {
+      break;
+    }
+  }
+  bool done = job->done;
+  if (done) {
+    *result = job->result;
+  } else {
+    job->abandoned = true;
+  }
+  pthread_mutex_unlock(&job->mutex);
+  if (done) {
+    job_free(job);
+  }
+  return done;
+}
@@ -0,0 +1,23 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+struct deadline {
+  bool enabled;
+  struct timespec expires; // CLOCK_MONOTONIC
+};
+
+typedef void *(*deadline_fn_t)(void *arg);
+typedef void (*deadline_discard_t)(void *result);
+
+void deadline_start(struct deadline *deadline, uint64_t budget_ns);
+bool deadline_run(const struct deadline *deadline,
+                  deadline_fn_t fn,
+                  void *arg,
+                  deadline_discard_t discard,
+                  void **result);
+
+#endif
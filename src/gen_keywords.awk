@@ -0,0 +1,94 @@
+# Generate keyword lookup from keywords.def. Keywords are dispatched with a
+# switch on their length and first character followed by a single memcmp.
+#
+# Usage: awk -v header=keywords.h -v source=keywords.c -f gen_keywords.awk keywords.def
+
+/^#/ || NF == 0 {
+  next
+}
+
+NF != 2 {
+  printf "%s:%d: expected NAME KEYWORD\n", FILENAME, FNR > "/dev/stderr"
+  failed = 1
+  exit 1
+}
+
+{
+  if ($2 in seen) {
+    printf "%s:%d: duplicate keyword %s\n", FILENAME, FNR, $2 > "/dev/stderr"
+    failed = 1
+    exit 1
+  }
+  seen[$2] = 1
+  count++
+  names[count] = $1
+  keywords[count] = $2
+  if (length($2) > max_length) {
+    max_length = length($2)
+  }
+}
+
+END {
+  if (failed) {
+    exit 1
+  }
+
+  print "// Generated from keywords.def by gen_keywords.awk. Do not edit." > header
+  print "#ifndef KEYWORDS_H" > header
+  print "#define KEYWORDS_H" > header
+  print "" > header
+  print "#include <stddef.h>" > header
+  print "" > header
+  print "enum keyword {" > header
+  print "  KEYWORD_NONE," > header
+  for (i = 1; i <= count; i++) {
+    printf "  KEYWORD_%s,\n", names[i] > header
+  }
+  print "};" > header
+  print "" > header
+  print "enum keyword keyword_lookup(const char *str, size_t length);" > header
+  print "" > header
+  print "#endif" > header
+
+  print "// Generated from keywords.def by gen_keywords.awk. Do not edit." > source
+  print "#include \"keywords.h\"" > source
+  print "" > source
+  print "#include <string.h>" > source
+  print "" > source
+  print "enum keyword keyword_lookup(const char *str, size_t length) {" > source
+  print "  switch (length) {" > source
+  for (len = 1; len <= max_length; len++) {
+    firsts = ""
+    for (i = 1; i <= count; i++) {
+      if (length(keywords[i]) != len) {
+        continue
+      }
+      first = substr(keywords[i], 1, 1)
+      if (index(firsts, first) == 0) {
+        firsts = firsts first
+      }
+    }
+    if (firsts == "") {
+      continue
+    }
+    printf "  case %d:\n", len > source
+    print "    switch (str[0]) {" > source
+    for (j = 1; j <= length(firsts); j++) {
+      first = substr(firsts, j, 1)
+      printf "    case '%s':\n", first > source
+      for (i = 1; i <= count; i++) {
+        if (length(keywords[i]) == len && substr(keywords[i], 1, 1) == first) {
+          printf "      if (!memcmp(str, \"%s\", %d)) {\n", keywords[i], len > source
+          printf "        return KEYWORD_%s;\n", names[i] > source
+          print "      }" > source
+        }
+      }
+      print "      break;" > source
+    }
+    print "    }" > source
+    print "    break;" > source
+  }
+  print "  }" > source
+  print "  return KEYWORD_NONE;" > source
+  print "}" > source
+}
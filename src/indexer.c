@@ -2,16 +2,21 @@
 
 #include "indexer.h"
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #ifdef HAVE_GETRANDOM
 #include <sys/random.h>
 #endif
 
 #include "utils.h"
 
-void init_random(void) {
+// Seeded on first use so that only the random method pays for the entropy
+static void init_random(void) {
 #ifdef HAVE_DRAND48
   #define INIT_FN srand48
   #define SEED_TYPE long int
@@ -37,15 +42,24 @@ size_t index_sequential(size_t palette_size, size_t ind, UNUSED const char *star
   return ind % palette_size;
 }
 
-size_t index_hash(size_t palette_size, UNUSED size_t ind, const char *start, const char *end) {
+static size_t hash_component(const char *start, const char *end) {
   size_t hash = 5381;
   for (const char *c = start; c < end; c++) {
     hash = ((hash << 5) + hash) + (size_t)*c;
   }
-  return hash % palette_size;
+  return hash;
+}
+
+size_t index_hash(size_t palette_size, UNUSED size_t ind, const char *start, const char *end) {
+  return hash_component(start, end) % palette_size;
 }
 
 size_t index_random(size_t palette_size, UNUSED size_t ind, UNUSED const char *start, UNUSED const char *end) {
+  static bool seeded = false;
+  if (!seeded) {
+    init_random();
+    seeded = true;
+  }
   #ifdef HAVE_DRAND48
   return drand48() * palette_size;
   #else
@@ -53,13 +67,62 @@ size_t index_random(size_t palette_size, UNUSED size_t ind, UNUSED const char *s
   #endif
 }
 
+// Seed shared by all invocations within a session. $RAINBOWPATH_SEED takes
+// precedence, followed by the controlling terminal and the session ID.
+static uint64_t session_seed(void) {
+  static uint64_t seed = 0;
+  static bool initialized = false;
+  if (initialized) {
+    return seed;
+  }
+  const char *env_seed = get_env("RAINBOWPATH_SEED");
+  struct stat buf;
+  if (env_seed) {
+    seed = hash_component(env_seed, env_seed + strlen(env_seed));
+  } else if (fstat(STDERR_FILENO, &buf) == 0 && S_ISCHR(buf.st_mode)) {
+    seed = buf.st_rdev;
+  } else {
+    seed = getsid(0);
+  }
+  initialized = true;
+  return seed;
+}
+
+// Single wyrand step
+static inline uint64_t wyrand(uint64_t state) {
+  state += UINT64_C(0xa0761d6478bd642f);
+  __uint128_t product = (__uint128_t)state * (state ^ UINT64_C(0xe7037ed1a0b428db));
+  return (uint64_t)(product >> 64) ^ (uint64_t)product;
+}
+
+size_t index_random_stable(size_t palette_size, UNUSED size_t ind, const char *start, const char *end) {
+  return wyrand(session_seed() ^ hash_component(start, end)) % palette_size;
+}
+
+static const struct {
+  const char *name;
+  indexer_t indexer;
+} INDEXERS[] = {
+  { "sequential", index_sequential },
+  { "hash", index_hash },
+  { "random", index_random },
+  { "random-stable", index_random_stable },
+};
+
 indexer_t get_indexer(const char *name) {
-  if (!strcmp(name, "sequential")) {
-    return index_sequential;
-  } else if (!strcmp(name, "hash")) {
-    return index_hash;
-  } else if (!strcmp(name, "random")) {
-    return index_random;
+  for (size_t i = 0; i < ARRAY_SIZE(INDEXERS); i++) {
+    if (!strcmp(name, INDEXERS[i].name)) {
+      return INDEXERS[i].indexer;
+    }
+  }
+  return NULL;
+}
+
+const char *indexer_name(indexer_t indexer) {
+  for (size_t i = 0; i < ARRAY_SIZE(INDEXERS); i++) {
+    if (INDEXERS[i].indexer == indexer) {
+      return INDEXERS[i].name;
+    }
   }
   return NULL;
 }
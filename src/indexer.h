@@ -3,8 +3,6 @@
 
 #include <stddef.h>
 
-void init_random(void);
-
 typedef size_t (*indexer_t)(
   size_t palette_size,
   size_t ind,
@@ -15,7 +13,9 @@ typedef size_t (*indexer_t)(
 size_t index_sequential(size_t palette_size, size_t ind, const char *start, const char *end);
 size_t index_hash(size_t palette_size, size_t ind, const char *start, const char *end);
 size_t index_random(size_t palette_size, size_t ind, const char *start, const char *end);
+size_t index_random_stable(size_t palette_size, size_t ind, const char *start, const char *end);
 
 indexer_t get_indexer(const char *name);
+const char *indexer_name(indexer_t indexer);
 
 #endif
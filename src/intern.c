@@ -0,0 +1,39 @@
+#include "intern.h"
+
+#include <stdlib.h>
+
+#include "utils.h"
+
+// Entries are allocated on first use. Keys are probed linearly for a limited
+// distance. When there is no room within that distance, the entry at the
+// home position is replaced, so memory use stays bounded and the table keeps
+// up with keys that change over time.
+
+struct intern_table *intern_table_create(void) {
+  struct intern_table *table = check(calloc(1, sizeof(*table)));
+  return table;
+}
+
+// Add an entry for a key that is not present and return its value for the
+// caller to fill in
+size_t *intern_table_add(struct intern_table *table, const struct intern_key *key) {
+  if (!table->entries) {
+    table->entries = check(calloc(INTERN_CAPACITY, sizeof(*table->entries)));
+  }
+  size_t home = intern_key_hash(key);
+  struct intern_entry *entry = &table->entries[home & (INTERN_CAPACITY - 1)];
+  for (size_t i = 0; i < INTERN_PROBE_LIMIT; i++) {
+    struct intern_entry *candidate = &table->entries[(home + i) & (INTERN_CAPACITY - 1)];
+    if (!candidate->key.length) {
+      entry = candidate;
+      break;
+    }
+  }
+  entry->key = *key;
+  return &entry->value;
+}
+
+void intern_table_free(struct intern_table *table) {
+  free(table->entries);
+  free(table);
+}
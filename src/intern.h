@@ -0,0 +1,112 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bounded open addressing table mapping short keys to values. Lookups are
+// made for every path component and are inlined, only adding keys goes
+// through a call.
+
+enum {
+  INTERN_KEY_WORDS = 4, // Enough for keys of up to 32 bytes
+  INTERN_CAPACITY = 4096, // Power of two
+  INTERN_PROBE_LIMIT = 8
+};
+
+// Keys are stored as up to four possibly overlapping words read from the
+// start and the end of the key. Together with the length, these identify
+// the key.
+struct intern_key {
+  size_t length;
+  uint64_t words[INTERN_KEY_WORDS];
+};
+
+struct intern_entry {
+  struct intern_key key; // Empty if the length is zero
+  size_t value;
+};
+
+struct intern_table {
+  struct intern_entry *entries;
+  size_t hits;
+  size_t misses;
+};
+
+struct intern_table *intern_table_create(void);
+size_t *intern_table_add(struct intern_table *table, const struct intern_key *key);
+void intern_table_free(struct intern_table *table);
+
+static inline uint64_t intern_load64(const char *data) {
+  uint64_t word;
+  memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+static inline uint64_t intern_load32(const char *data) {
+  uint32_t word;
+  memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+// Returns false if the key is too long to be stored
+static inline bool intern_key_init(struct intern_key *key, const char *data, size_t length) {
+  if (length == 0 || length > INTERN_KEY_WORDS * sizeof(uint64_t)) {
+    return false;
+  }
+  key->length = length;
+  key->words[1] = key->words[2] = key->words[3] = 0;
+  if (length >= 8) {
+    key->words[0] = intern_load64(data);
+    key->words[1] = intern_load64(data + length - 8);
+    if (length > 16) {
+      key->words[2] = intern_load64(data + 8);
+      key->words[3] = intern_load64(data + length - 16);
+    }
+  } else if (length >= 4) {
+    key->words[0] = intern_load32(data) | intern_load32(data + length - 4) << 32;
+  } else {
+    key->words[0] = (uint64_t)(unsigned char)data[0]
+      | (uint64_t)(unsigned char)data[length / 2] << 8
+      | (uint64_t)(unsigned char)data[length - 1] << 16;
+  }
+  return true;
+}
+
+static inline size_t intern_key_hash(const struct intern_key *key) {
+  uint64_t hash = (key->words[0] ^ key->length) * UINT64_C(0x9e3779b97f4a7c15);
+  hash = (hash ^ key->words[1] ^ key->words[2] ^ key->words[3]) * UINT64_C(0xff51afd7ed558ccd);
+  return hash >> 32;
+}
+
+static inline bool intern_key_equal(const struct intern_key *a, const struct intern_key *b) {
+  return a->length == b->length
+    && a->words[0] == b->words[0]
+    && a->words[1] == b->words[1]
+    && a->words[2] == b->words[2]
+    && a->words[3] == b->words[3];
+}
+
+// Find the value stored for the given bytes. Returns NULL if they have not
+// been added yet.
+static inline size_t *intern_table_find(struct intern_table *table, const struct intern_key *key) {
+  if (table->entries) {
+    size_t index = intern_key_hash(key);
+    for (size_t i = 0; i < INTERN_PROBE_LIMIT; i++, index++) {
+      struct intern_entry *entry = &table->entries[index & (INTERN_CAPACITY - 1)];
+      if (intern_key_equal(&entry->key, key)) {
+        table->hits++;
+        return &entry->value;
+      }
+      if (!entry->key.length) {
+        break;
+      }
+    }
+  }
+  table->misses++;
+  return NULL;
+}
+
+#endif
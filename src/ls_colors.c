@@ -0,0 +1,248 @@
+#include "build.h"
+
+#include "ls_colors.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "vector.h"
+
+// LS_COLORS is a colon separated list of KEY=SGR entries, where keys are
+// either two letter file type codes or patterns such as *.tar.gz matching
+// the end of file names. The list is parsed once into control sequences.
+// Patterns starting with a dot are kept in a hash table keyed by the suffix,
+// so that the longest matching suffix of a name is found with a lookup at
+// each dot of the name. Other patterns are rare and compared one by one.
+
+enum ls_type {
+  LS_DIRECTORY,
+  LS_LINK,
+  LS_ORPHAN,
+  LS_FIFO,
+  LS_SOCKET,
+  LS_BLOCK,
+  LS_CHAR,
+  LS_EXECUTABLE,
+  LS_FILE,
+  LS_TYPE_COUNT
+};
+
+static const char *const TYPE_CODES[LS_TYPE_COUNT] = {
+  [LS_DIRECTORY] = "di",
+  [LS_LINK] = "ln",
+  [LS_ORPHAN] = "or",
+  [LS_FIFO] = "pi",
+  [LS_SOCKET] = "so",
+  [LS_BLOCK] = "bd",
+  [LS_CHAR] = "cd",
+  [LS_EXECUTABLE] = "ex",
+  [LS_FILE] = "fi",
+};
+
+struct suffix {
+  struct string_view suffix; // Empty if the slot is unused
+  struct string_view sequence;
+};
+
+struct ls_colors {
+  struct string_view types[LS_TYPE_COUNT]; // Empty if not set
+  bool stat_types; // Whether any type other than directories needs a stat
+  struct suffix *suffixes; // Patterns starting with a dot
+  size_t capacity; // Power of two
+  size_t longest; // Length of the longest of them
+  struct vector *others; // Of struct suffix, longest first
+};
+
+static size_t hash_suffix(const char *data, size_t length) {
+  uint64_t hash = UINT64_C(0xcbf29ce484222325);
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)data[i]) * UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+static struct string_view sequence(struct arena *arena,
+                                   const char *sgr,
+                                   size_t length,
+                                   bool bash_escape) {
+  size_t size = length + 3 + (bash_escape ? 4 : 0);
+  char *data = arena_alloc(arena, size);
+  char *pos = data;
+  if (bash_escape) {
+    memcpy(pos, "\\[", 2);
+    pos += 2;
+  }
+  memcpy(pos, "\e[", 2);
+  memcpy(pos + 2, sgr, length);
+  pos[length + 2] = 'm';
+  pos += length + 3;
+  if (bash_escape) {
+    memcpy(pos, "\\]", 2);
+  }
+  return (struct string_view){ data, size };
+}
+
+static void add_suffix(struct ls_colors *colors, const struct suffix *suffix) {
+  size_t mask = colors->capacity - 1;
+  size_t slot = hash_suffix(suffix->suffix.data, suffix->suffix.length) & mask;
+  for (; colors->suffixes[slot].suffix.length; slot = (slot + 1) & mask) {
+    const struct string_view *existing = &colors->suffixes[slot].suffix;
+    // Later entries take precedence
+    if (existing->length == suffix->suffix.length
+        && !memcmp(existing->data, suffix->suffix.data, existing->length)) {
+      break;
+    }
+  }
+  colors->suffixes[slot] = *suffix;
+}
+
+// Links styled as their targets are left unstyled instead
+static bool is_target(const char *value, const char *end) {
+  return end - value == 6 && !memcmp(value, "target", 6);
+}
+
+// Entries that cannot be understood are skipped, like ls does
+struct ls_colors *ls_colors_parse(struct arena *arena, const char *spec, bool bash_escape) {
+  struct ls_colors *colors = arena_calloc(arena, 1, sizeof(*colors));
+  struct vector *dotted = vector_create(arena, sizeof(struct suffix));
+  colors->others = vector_create(arena, sizeof(struct suffix));
+  const char *pos = spec;
+  while (*pos) {
+    const char *entry_end = strchrnul(pos, ':');
+    const char *equals = memchr(pos, '=', entry_end - pos);
+    if (equals && equals + 1 < entry_end) {
+      struct string_view sgr = sequence(arena, equals + 1, entry_end - equals - 1, bash_escape);
+      if (*pos == '*' && equals - pos > 1) {
+        struct vector *patterns = pos[1] == '.' ? dotted : colors->others;
+        struct suffix *suffix = vector_push(patterns);
+        suffix->suffix = (struct string_view){ pos + 1, equals - pos - 1 };
+        suffix->sequence = sgr;
+      } else if (equals - pos == 2 && !is_target(equals + 1, entry_end)) {
+        for (size_t type = 0; type < LS_TYPE_COUNT; type++) {
+          if (!memcmp(pos, TYPE_CODES[type], 2)) {
+            colors->types[type] = sgr;
+            colors->stat_types |= type != LS_DIRECTORY;
+          }
+        }
+      }
+    }
+    pos = *entry_end ? entry_end + 1 : entry_end;
+  }
+
+  colors->capacity = 16;
+  while (colors->capacity < 2 * vector_size(dotted)) {
+    colors->capacity *= 2;
+  }
+  colors->suffixes = arena_calloc(arena, colors->capacity, sizeof(*colors->suffixes));
+  for (size_t i = 0; i < vector_size(dotted); i++) {
+    const struct suffix *suffix = vector_get(dotted, i);
+    add_suffix(colors, suffix);
+    if (suffix->suffix.length > colors->longest) {
+      colors->longest = suffix->suffix.length;
+    }
+  }
+  // Longest first, and later entries before earlier ones of the same length
+  struct suffix *others = colors->others->data;
+  size_t count = vector_size(colors->others);
+  for (size_t i = 1; i < count; i++) {
+    struct suffix other = others[i];
+    size_t j = i;
+    for (; j && others[j - 1].suffix.length <= other.suffix.length; j--) {
+      others[j] = others[j - 1];
+    }
+    others[j] = other;
+  }
+  return colors;
+}
+
+static const struct string_view *find_suffix(const struct ls_colors *colors,
+                                             const char *name,
+                                             size_t length) {
+  const char *end = name + length;
+  // Leftmost dots give the longest suffixes
+  const char *dot = length > colors->longest ? end - colors->longest : name;
+  size_t mask = colors->capacity - 1;
+  while ((dot = memchr(dot, '.', end - dot))) {
+    size_t suffix_length = end - dot;
+    size_t slot = hash_suffix(dot, suffix_length) & mask;
+    for (; colors->suffixes[slot].suffix.length; slot = (slot + 1) & mask) {
+      const struct suffix *suffix = &colors->suffixes[slot];
+      if (suffix->suffix.length == suffix_length
+          && !memcmp(suffix->suffix.data, dot, suffix_length)) {
+        return &suffix->sequence;
+      }
+    }
+    dot++;
+  }
+  const struct suffix *others = colors->others->data;
+  for (size_t i = 0; i < vector_size(colors->others); i++) {
+    const struct string_view *suffix = &others[i].suffix;
+    if (suffix->length <= length && !memcmp(end - suffix->length, suffix->data, suffix->length)) {
+      return &others[i].sequence;
+    }
+  }
+  return NULL;
+}
+
+static enum ls_type file_type(const char *path, size_t length, bool directory) {
+  char buffer[PATH_MAX];
+  struct stat st;
+  if (length >= sizeof(buffer)) {
+    return directory ? LS_DIRECTORY : LS_FILE;
+  }
+  memcpy(buffer, path, length);
+  buffer[length] = '\0';
+  if (lstat(buffer, &st) != 0) {
+    return directory ? LS_DIRECTORY : LS_FILE;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    return LS_DIRECTORY;
+  } else if (S_ISLNK(st.st_mode)) {
+    return stat(buffer, &st) == 0 ? LS_LINK : LS_ORPHAN;
+  } else if (S_ISFIFO(st.st_mode)) {
+    return LS_FIFO;
+  } else if (S_ISSOCK(st.st_mode)) {
+    return LS_SOCKET;
+  } else if (S_ISBLK(st.st_mode)) {
+    return LS_BLOCK;
+  } else if (S_ISCHR(st.st_mode)) {
+    return LS_CHAR;
+  } else if (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) {
+    return LS_EXECUTABLE;
+  }
+  return LS_FILE;
+}
+
+// Find the sequence styling the file at path, whose last component is name.
+// A trailing separator marks a directory. The file is only looked up when
+// types other than directories are styled, so a directory without a trailing
+// separator is otherwise taken for a regular file. Files that are not regular
+// are styled by their type only, like ls does, and regular files by the
+// suffix of their name. Returns NULL if nothing applies.
+const struct string_view *ls_colors_find(const struct ls_colors *colors,
+                                         const char *path,
+                                         size_t length,
+                                         const char *name,
+                                         size_t name_length,
+                                         bool directory) {
+  enum ls_type type = directory ? LS_DIRECTORY : LS_FILE;
+  if (colors->stat_types) {
+    type = file_type(path, length, directory);
+  }
+  if (type == LS_ORPHAN && !colors->types[LS_ORPHAN].length) {
+    type = LS_LINK;
+  }
+  if (type != LS_FILE && colors->types[type].length) {
+    return &colors->types[type];
+  }
+  if (type != LS_FILE && type != LS_EXECUTABLE) {
+    return NULL;
+  }
+  const struct string_view *suffix = find_suffix(colors, name, name_length);
+  if (suffix) {
+    return suffix;
+  }
+  return colors->types[LS_FILE].length ? &colors->types[LS_FILE] : NULL;
+}
@@ -0,0 +1,20 @@
+#ifndef LS_COLORS_H
+#define LS_COLORS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "parser_common.h"
+
+struct ls_colors;
+
+struct ls_colors *ls_colors_parse(struct arena *arena, const char *spec, bool bash_escape);
+const struct string_view *ls_colors_find(const struct ls_colors *colors,
+                                         const char *path,
+                                         size_t length,
+                                         const char *name,
+                                         size_t name_length,
+                                         bool directory);
+
+#endif
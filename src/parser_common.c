@@ -12,11 +12,14 @@ void parse_error(const char *message) {
   fprintf(stderr, "%s\n", message);
 }
 
-static char *make_string(const char *begin, const char *end) {
-  assert(end >= begin);
-  size_t size = end - begin;
-  char *result = check(calloc(size + 1, sizeof(char)));
-  return memcpy(result, begin, size);
+bool view_to_ssize(const struct string_view *view, ssize_t *result) {
+  char buffer[32];
+  if (view->length >= sizeof(buffer)) {
+    return false;
+  }
+  memcpy(buffer, view->data, view->length);
+  buffer[view->length] = '\0';
+  return parse_ssize(buffer, result);
 }
 
 bool at_end(const char *pos, const char *end) {
@@ -57,7 +60,7 @@ const char *parse_char(const char *pos, const char *end, char c) {
   return ++pos;
 }
 
-const char *parse_token(const char *pos, const char *end, char **token) {
+const char *parse_token(const char *pos, const char *end, struct string_view *token) {
   pos = skip_whitespace(pos, end);
   if (at_end(pos, end)) {
     return NULL;
@@ -69,7 +72,8 @@ const char *parse_token(const char *pos, const char *end, char **token) {
   if (start == pos) {
     return NULL;
   }
-  *token = make_string(start, pos);
+  token->data = start;
+  token->length = pos - start;
   return pos;
 }
 
@@ -94,3 +98,36 @@ bool parse_ssize(const char *str, ssize_t *result) {
   return true;
 }
 
+
+bool parse_duration(const char *str, uint64_t *result) {
+  static const struct {
+    const char *unit;
+    uint64_t scale;
+  } UNITS[] = {
+    { "", 1000000 },
+    { "ns", 1 },
+    { "us", 1000 },
+    { "ms", 1000000 },
+    { "s", 1000000000 },
+  };
+  unsigned long long num;
+  char *num_end;
+  if (!('0' <= *str && *str <= '9')) {
+    return false;
+  }
+  errno = 0;
+  num = strtoull(str, &num_end, 10);
+  if (errno == ERANGE) {
+    return false;
+  }
+  for (size_t i = 0; i < ARRAY_SIZE(UNITS); i++) {
+    if (!strcmp(num_end, UNITS[i].unit)) {
+      if (num > UINT64_MAX / UNITS[i].scale) {
+        return false;
+      }
+      *result = num * UNITS[i].scale;
+      return true;
+    }
+  }
+  return false;
+}
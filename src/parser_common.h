@@ -2,13 +2,24 @@
 #define PARSER_COMMON_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+// Tokens refer to the input they were parsed from instead of being copied
+struct string_view {
+  const char *data;
+  size_t length;
+};
+
+bool view_to_ssize(const struct string_view *view, ssize_t *result);
+
 void parse_error(const char *message);
 bool at_end(const char *pos, const char *end);
 const char *skip_whitespace(const char *pos, const char *end);
 const char *parse_char(const char *pos, const char *end, char c);
-const char *parse_token(const char *pos, const char *end, char **token);
+const char *parse_token(const char *pos, const char *end, struct string_view *token);
 bool parse_ssize(const char *str, ssize_t *result);
+bool parse_duration(const char *str, uint64_t *result);
 
 #endif
@@ -0,0 +1,59 @@
+#include "queue.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <semaphore.h>
+
+#include "utils.h"
+
+// Bounded queue between exactly one producer and one consumer thread. Items
+// are passed through a ring buffer whose positions are published with
+// release and acquire ordering, so neither side takes a lock. A semaphore
+// counts the available items so that an idle consumer sleeps instead of
+// spinning. Producers must never push more items than the capacity.
+
+struct queue {
+  size_t capacity;
+  _Atomic size_t head; // Next position to pop, written by the consumer
+  _Atomic size_t tail; // Next position to push, written by the producer
+  sem_t available;
+  void **items;
+};
+
+struct queue *queue_create(size_t capacity) {
+  struct queue *queue = check(malloc(sizeof(*queue)));
+  queue->capacity = capacity;
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+  sem_init(&queue->available, 0, 0);
+  queue->items = check(calloc(capacity, sizeof(*queue->items)));
+  return queue;
+}
+
+void queue_push(struct queue *queue, void *item) {
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  assert(tail - head < queue->capacity);
+  (void)head;
+  queue->items[tail % queue->capacity] = item;
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+  sem_post(&queue->available);
+}
+
+void *queue_pop(struct queue *queue) {
+  while (sem_wait(&queue->available) != 0);
+  size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  assert(head != tail);
+  (void)tail;
+  void *item = queue->items[head % queue->capacity];
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  return item;
+}
+
+void queue_free(struct queue *queue) {
+  sem_destroy(&queue->available);
+  free(queue->items);
+  free(queue);
+}
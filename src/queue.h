@@ -0,0 +1,13 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stddef.h>
+
+struct queue;
+
+struct queue *queue_create(size_t capacity);
+void queue_push(struct queue *queue, void *item);
+void *queue_pop(struct queue *queue);
+void queue_free(struct queue *queue);
+
+#endif
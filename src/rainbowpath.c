@@ -1,285 +1,334 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "utils.h"
 #include "args.h"
 #include "styles.h"
 #include "terminal.h"
 #include "indexer.h"
-#include "list.h"
+#include "vector.h"
 #include "config.h"
+#include "deadline.h"
+#include "watch.h"
+#include "render.h"
+#include "stream.h"
+#include "tree.h"
+#include "parser_common.h"
 
-static void begin_style(struct terminal *terminal,
-                        const struct style *style,
-                        bool bash_escape) {
-  if (bash_escape) {
-    fputs("\\[", stdout);
-  }
-  if (bool_attr_enabled(&style->bold)) {
-    terminal_bold(terminal);
-  }
-  if (bool_attr_enabled(&style->dim)) {
-    terminal_dim(terminal);
-  }
-  if (bool_attr_enabled(&style->underlined)) {
-    terminal_underlined(terminal);
-  }
-  if (bool_attr_enabled(&style->blink)) {
-    terminal_blink(terminal);
-  }
-  if (style->bg.state == ATTR_STATE_SET) {
-    terminal_bg(terminal, style->bg.value);
-  }
-  if (style->fg.state == ATTR_STATE_SET) {
-    terminal_fg(terminal, style->fg.value);
-  }
-  if (bash_escape) {
-    fputs("\\]", stdout);
+// /proc/PID/cwd cannot be watched with inotify
+#define PROCESS_POLL_INTERVAL 1000
+
+// Set while the working directory is being read. When the watch mode polls
+// a process that blocks the read, no further jobs are started until the
+// abandoned one finishes, so blocked threads do not pile up.
+static atomic_bool working_directory_busy = false;
+
+static void *working_directory_job(void *arg) {
+  const struct config *config = arg;
+  char *path;
+  if (config->path_file) {
+    path = read_first_line(config->path_file);
+  } else if (config->pid) {
+    path = get_process_working_directory(config->pid);
+  } else {
+    path = get_working_directory();
   }
+  atomic_store(&working_directory_busy, false);
+  return path;
 }
 
-static void end_style(struct terminal *terminal, bool bash_escape) {
-  if (bash_escape) {
-    fputs("\\[", stdout);
-  }
-  terminal_reset_style(terminal);
-  if (bash_escape) {
-    fputs("\\]", stdout);
-  }
+// The argument carries the mask of fields set on the command line
+static void *config_job(void *arg) {
+  return config_load_layer((uintptr_t)arg);
 }
 
-static void merge_color_attr(const struct color_attr *lower,
-                             const struct color_attr *upper,
-                             struct color_attr *result) {
-  result->state = lower->state;
-  result->value = lower->value;
-  switch (upper->state){
-  case ATTR_STATE_UNSET:
-    break;
-  case ATTR_STATE_SET:
-    result->state = ATTR_STATE_SET;
-    result->value = upper->value;
-    break;
-  case ATTR_STATE_REVERTED:
-    result->state = ATTR_STATE_UNSET;
-    break;
-  }
+static void *config_file_job(void *arg) {
+  return config_load_file((uintptr_t)arg);
 }
 
-static void merge_bool_attr(const struct bool_attr *lower,
-                            const struct bool_attr *upper,
-                            struct bool_attr *result) {
-  result->state = lower->state;
-  result->value = lower->value;
-  switch (upper->state){
-  case ATTR_STATE_UNSET:
-    break;
-  case ATTR_STATE_SET:
-    result->state = ATTR_STATE_SET;
-    result->value = upper->value;
-    break;
-  case ATTR_STATE_REVERTED:
-    result->state = ATTR_STATE_UNSET;
-    break;
+static void *terminal_job(UNUSED void *arg) {
+  return terminal_create();
+}
+
+static char *get_path(struct config *config, const struct deadline *deadline) {
+  char *path = NULL;
+  if (config->path_count) {
+    return check(strdup(config->paths[0]));
   }
+  bool done = !atomic_exchange(&working_directory_busy, true)
+    && deadline_run(deadline, working_directory_job, config, free, (void **)&path);
+  if (!done && !config->path_file && !config->pid) {
+    const char *pwd = get_env("PWD");
+    path = pwd ? check(strdup(pwd)) : NULL;
+  }
+  if (!path) {
+    fputs("Failed to get working directory\n", stderr);
+  }
+  return path;
 }
 
-static void merge_styles(const struct style *lower,
-                         const struct style *upper,
-                         struct style *result) {
-  merge_color_attr(&lower->fg, &upper->fg, &result->fg);
-  merge_color_attr(&lower->bg, &upper->bg, &result->bg);
-  merge_bool_attr(&lower->bold, &upper->bold, &result->bold);
-  merge_bool_attr(&lower->dim, &upper->dim, &result->dim);
-  merge_bool_attr(&lower->underlined, &upper->underlined, &result->underlined);
-  merge_bool_attr(&lower->blink, &upper->blink, &result->blink);
+static struct string_view record_terminator(const struct config *config) {
+  if (config->terminator) {
+    return (struct string_view){ config->terminator, strlen(config->terminator) };
+  }
+  return (struct string_view){ &config->delimiter, 1 };
 }
 
-static char *compact_path(const char *path) {
-  const char *home = get_home_directory();
-  if (!home) {
-    return NULL;
-  }
-  const size_t path_len = strlen(path);
-  const size_t home_len = strlen(home);
-  if (strncmp(path, home, home_len) == 0) {
-    const char next = *(path + home_len);
-    if (next == '/' || !next) {
-      const size_t result_size = path_len - home_len + 2;
-      char *result = check(malloc(result_size));
-      strncpy(result, "~", result_size);
-      strncat(result, path + home_len, result_size - 1);
-      return result;
+// Render all paths into one buffer so that they are written out at once.
+// Each path is followed by the terminator, apart from the last one when new
+// lines are disabled.
+static void print_paths(const struct renderer *renderer,
+                        const struct config *config,
+                        char *const *paths,
+                        size_t count) {
+  struct string_view terminator = record_terminator(config);
+  struct bytes *out = bytes_create(NULL);
+  for (size_t i = 0; i < count; i++) {
+    render_path(renderer, NULL, out, paths[i], strlen(paths[i]));
+    if (i + 1 < count || config->new_line) {
+      bytes_append(out, terminator.data, terminator.length);
     }
   }
-  return check(strdup(path));
+  fwrite(bytes_data(out), 1, bytes_size(out), stdout);
+  bytes_free(out);
 }
 
-static void strip_leading(char *path) {
-  const char *pos = path; 
-  for (; *pos == '/'; pos++);
-  memmove(path, pos, strlen(pos) + 1);
+// Render the paths read from the file at path
+static bool print_file(const struct renderer *renderer,
+                       const struct config *config,
+                       const char *path,
+                       const struct string_view *terminator,
+                       struct render_stats *stats) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return false;
+  }
+  bool ret = render_file(renderer,
+                         fd,
+                         STDOUT_FILENO,
+                         config->delimiter,
+                         terminator,
+                         config->jobs,
+                         config->max_latency,
+                         stats);
+  if (!ret) {
+    fprintf(stderr, "Failed to render paths from %s\n", path);
+  }
+  close(fd);
+  return ret;
 }
 
-static void path_component_count(const char *path,
-                                 size_t *segment_count,
-                                 size_t *separator_count) {
-  const char *sep;
-  size_t segments = 0;
-  size_t separators = 0;
-  while ((sep = strchr(path, '/'))) {
-    if (sep != path) {
-      segments++;
-    }
-    separators++;
-    path = sep + 1;
+// Add the paths read from the file at path to tree
+static bool read_tree_file(struct tree *tree, const char *path, char delimiter) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return false;
   }
-  if (*path) {
-    segments++;
+  bool ret = tree_read(tree, fd, delimiter);
+  if (!ret) {
+    fprintf(stderr, "Failed to read paths from %s\n", path);
   }
-  *segment_count = segments;
-  *separator_count = separators;
+  close(fd);
+  return ret;
 }
 
-static const struct style *select_style(const struct palette *palette,
-                                        const struct list *overrides,
-                                        indexer_t indexer,
-                                        size_t index,
-                                        size_t element_count,
-                                        const char *start,
-                                        const char *end,
-                                        struct style *tmp) {
-  bool merged = false;
-  size_t selected = indexer(palette_size(palette), index, start, end);
-  const struct style *style = palette_get(palette, selected);
-  struct list_elem *elem = list_first(overrides);
-  while (elem) {
-    struct override *override = (struct override *)list_elem_value(elem);
-    if (override_index(override, element_count) == index) {
-      merge_styles(merged ? tmp : style, override->style, tmp);
-      merged = true;
+// Show the paths read from standard input, the file given with --from-file or
+// the files given with --input as one tree
+static bool print_tree(const struct renderer *renderer,
+                       const struct config *config,
+                       const struct string_view *terminator) {
+  bool ret = true;
+  struct tree *tree = tree_create(renderer, config, STDOUT_FILENO, terminator);
+  if (config->input) {
+    for (size_t i = 0; i < config->path_count; i++) {
+      ret = read_tree_file(tree, config->paths[i], config->delimiter) && ret;
     }
-    elem = list_elem_next(elem);
+  } else if (config->from_file) {
+    ret = read_tree_file(tree, config->from_file, config->delimiter);
+  } else if (!tree_read(tree, STDIN_FILENO, config->delimiter)) {
+    fputs("Failed to read paths\n", stderr);
+    ret = false;
+  }
+  if (!tree_finish(tree)) {
+    fputs("Failed to write tree\n", stderr);
+    ret = false;
   }
-  return merged ? tmp : style;
+  tree_free(tree);
+  return ret;
 }
 
-static char *get_path(struct config *config) {
-  char *path = NULL;
-  if (config->path) {
-    path = check(strdup(config->path));
+// Render the paths read from standard input, the file given with --from-file
+// or the files given with --input. Files are rendered one after another, and
+// the remaining files are still rendered when one fails.
+static bool print_input(const struct renderer *renderer, const struct config *config) {
+  struct string_view terminator = record_terminator(config);
+  if (config->tree) {
+    return print_tree(renderer, config, &terminator);
+  }
+  struct render_stats stats = { 0 };
+  bool ret = true;
+  if (config->input) {
+    for (size_t i = 0; i < config->path_count; i++) {
+      ret = print_file(renderer, config, config->paths[i], &terminator, &stats) && ret;
+    }
+  } else if (config->from_file) {
+    ret = print_file(renderer, config, config->from_file, &terminator, &stats);
   } else {
-    path = get_working_directory();
-    if (!path) {
-      fputs("Failed to get working directory\n", stderr);
-      goto error;
+    ret = render_stream(renderer,
+                        STDIN_FILENO,
+                        STDOUT_FILENO,
+                        config->delimiter,
+                        &terminator,
+                        config->jobs,
+                        config->max_latency,
+                        &stats);
+    if (!ret) {
+      fputs("Failed to render paths\n", stderr);
     }
   }
-  if (config->compact) {
-    char *compacted = compact_path(path);
-    if (!compacted) {
-      fputs("Failed to get home directory\n", stderr);
-      goto error;
+  if (config->stats) {
+    fprintf(stderr, "Component cache: %zu hits, %zu misses\n",
+            stats.name_hits, stats.name_misses);
+    fprintf(stderr, "Reused prefixes: %zu paths\n", stats.reused_paths);
+  }
+  return ret;
+}
+
+// Parse the arguments and the configuration file again into a fresh
+// configuration. Returns NULL if the configuration file is invalid. When
+// loading the file takes longer than the deadline, the defaults are used if
+// initial is set, and NULL is returned otherwise.
+static struct config *reload_config(int argc, char **argv, bool initial) {
+  struct config *config = config_create();
+  bool exit;
+  if (!parse_args(argc, argv, config, &exit)) {
+    goto error;
+  }
+  struct deadline deadline;
+  deadline_start(&deadline, config->deadline);
+  struct config *file_config;
+  if (!deadline_run(&deadline, config_file_job, (void *)(uintptr_t)config->fields,
+                    (deadline_discard_t)config_free, (void **)&file_config)) {
+    if (initial) {
+      return config;
     }
-    free(path);
-    path = compacted;
+    goto error;
   }
-  if (config->strip_leading) {
-    strip_leading(path);
+  if (!file_config) {
+    fputs("Failed to load configuration file\n", stderr);
+    goto error;
   }
-  return path;
+  config_merge(config, file_config);
+  config_free(file_config);
+  return config;
  error:
-  if (path) {
-    free(path);
-  }
+  config_free(config);
   return NULL;
 }
 
-static bool print_path(struct terminal *terminal, struct config *config) {
+static bool watch_path(int argc,
+                       char **argv,
+                       struct terminal *terminal,
+                       struct config *config) {
   bool ret = false;
-  const struct palette *path_palette = config_path_palette(terminal, config);
-  const struct palette *separator_palette = config_separator_palette(terminal, config);
-  const char *sep;
-  size_t path_index = 0;
-  size_t separator_index = 0;
-  const struct style *style;
-  struct style tmp_style;
-
-  char *full_path = get_path(config);
-  if (!full_path) {
-    return false;
+  char *last_path = NULL;
+  struct watch *watch = watch_create();
+  if (!watch) {
+    fputs("Failed to watch for changes\n", stderr);
+    goto out;
   }
-  const char *path = full_path;
-
-  size_t segment_count;
-  size_t separator_count;
-  path_component_count(path, &segment_count, &separator_count);
-
-  while ((sep = strchr(path, '/'))) {
-    if (sep != path) {
-      style = select_style(path_palette,
-                           config->path_overrides,
-                           config->path_indexer,
-                           path_index,
-                           segment_count,
-                           path,
-                           sep,
-                           &tmp_style);
-      begin_style(terminal, style, config->bash_escape);
-      fwrite(path, 1, sep - path, stdout);
-      end_style(terminal, config->bash_escape);
-      path_index++;
-    }
-
-    style = select_style(separator_palette,
-                         config->separator_overrides,
-                         config->separator_indexer,
-                         separator_index,
-                         separator_count,
-                         sep,
-                         sep + 1,
-                         &tmp_style);
-    begin_style(terminal, style, config->bash_escape);
-    fputs(config->separator, stdout);
-    end_style(terminal, config->bash_escape);
-    separator_index++;
-    path = sep + 1;
+  // Configuration directories that do not exist cannot be watched
+  char *config_paths[CONFIG_WATCH_PATHS];
+  size_t config_path_count = config_watch_paths(config_paths);
+  for (size_t i = 0; i < config_path_count; i++) {
+    watch_add(watch, config_paths[i], WATCH_EVENT_CONFIG);
+    free(config_paths[i]);
   }
-
-  if (*path) {
-    style = select_style(path_palette,
-                         config->path_overrides,
-                         config->path_indexer,
-                         path_index,
-                         segment_count,
-                         path,
-                         path + strlen(path),
-                         &tmp_style);
-    begin_style(terminal, style, config->bash_escape);
-    fputs(path, stdout);
-    end_style(terminal, config->bash_escape);
+  if (config->path_file && !watch_add(watch, config->path_file, WATCH_EVENT_TARGET)) {
+    fputs("Failed to watch path file\n", stderr);
+    goto out;
   }
+  const int timeout = config->pid ? PROCESS_POLL_INTERVAL : -1;
 
-  if (config->new_line) {
-    fputc('\n', stdout);
+  // The snapshot is not reloaded, so start from the configuration file
+  // instead
+  config = reload_config(argc, argv, true);
+  if (!config) {
+    goto out;
+  }
+  const struct renderer *renderer = renderer_create(config->arena, terminal, config);
+  if (!renderer) {
+    config_free(config);
+    goto out;
+  }
+  unsigned int events = 0;
+  bool changed = true;
+  while (true) {
+    if (events & WATCH_EVENT_CONFIG) {
+      // Keep the previous configuration until the file is valid and loads
+      // before the deadline again
+      struct config *fresh = reload_config(argc, argv, false);
+      const struct renderer *fresh_renderer = NULL;
+      if (fresh) {
+        fresh_renderer = renderer_create(fresh->arena, terminal, fresh);
+      }
+      if (fresh_renderer) {
+        config_free(config);
+        config = fresh;
+        renderer = fresh_renderer;
+        changed = true;
+      } else if (fresh) {
+        config_free(fresh);
+      }
+    }
+    struct deadline deadline;
+    deadline_start(&deadline, config->deadline);
+    char *path = get_path(config, &deadline);
+    if (!path && config->pid && kill(config->pid, 0) != 0 && errno == ESRCH) {
+      // The process has exited
+      ret = true;
+      break;
+    }
+    if (path && (changed || !last_path || strcmp(path, last_path))) {
+      print_paths(renderer, config, &path, 1);
+      fflush(stdout);
+      free(last_path);
+      last_path = path;
+      changed = false;
+    } else {
+      free(path);
+    }
+    if (!watch_wait(watch, timeout, &events)) {
+      fputs("Failed to watch for changes\n", stderr);
+      break;
+    }
+  }
+  config_free(config);
+ out:
+  free(last_path);
+  if (watch) {
+    watch_free(watch);
   }
-
-  ret = true;
-  free(full_path);
   return ret;
 }
 
 int main(int argc, char *argv[]) {
   int ret = EXIT_FAILURE;
   struct config *config = config_create();
+  struct terminal *terminal = NULL;
 
-  init_random();
-
-  struct terminal *terminal = terminal_create();
-  if (!terminal) {
-    goto out;
-  }
+  // Output is written with a single write on exit
+  static char output_buffer[BUFSIZ];
+  setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
 
   bool exit;
   if (!parse_args(argc, argv, config, &exit)) {
@@ -291,19 +340,68 @@ int main(int argc, char *argv[]) {
     goto out;
   }
 
-  if (!config_load(config)) {
-    fputs("Failed to load configuration file\n", stderr);
+  // File system access is abandoned in favor of defaults once the deadline
+  // expires
+  struct deadline deadline;
+  deadline_start(&deadline, config->deadline);
+
+  if (!deadline_run(&deadline, terminal_job, NULL,
+                    (deadline_discard_t)terminal_free, (void **)&terminal)) {
+    terminal = terminal_create_fallback();
+  }
+  if (!terminal) {
+    goto out;
+  }
+
+  if (config->watch) {
+    if (watch_path(argc, argv, terminal, config)) {
+      ret = EXIT_SUCCESS;
+    }
     goto out;
   }
 
-  if (!print_path(terminal, config)) {
+  struct config *file_config;
+  if (deadline_run(&deadline, config_job, (void *)(uintptr_t)config->fields,
+                   (deadline_discard_t)config_free, (void **)&file_config)) {
+    if (!file_config) {
+      fputs("Failed to load configuration file\n", stderr);
+      goto out;
+    }
+    config_merge(config, file_config);
+    config_free(file_config);
+  }
+
+  const struct renderer *renderer = renderer_create(config->arena, terminal, config);
+  if (!renderer) {
     goto out;
   }
 
+  if (config->stream || config->from_file || config->input) {
+    if (print_input(renderer, config)) {
+      ret = EXIT_SUCCESS;
+    }
+    goto out;
+  }
+
+  if (config->path_count > 1) {
+    print_paths(renderer, config, config->paths, config->path_count);
+    ret = EXIT_SUCCESS;
+    goto out;
+  }
+
+  char *path = get_path(config, &deadline);
+  if (!path) {
+    goto out;
+  }
+  print_paths(renderer, config, &path, 1);
+  free(path);
+
   ret = EXIT_SUCCESS;
 
 out:
   config_free(config);
-  terminal_free(terminal);
+  if (terminal) {
+    terminal_free(terminal);
+  }
   return ret;
 }
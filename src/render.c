@@ -0,0 +1,820 @@
+#include "render.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "indexer.h"
+#include "intern.h"
+#include "ls_colors.h"
+#include "styles.h"
+#include "vector.h"
+#include "parser_common.h"
+
+// Paths are rendered into byte buffers. The control sequences for palette
+// styles are produced once when the renderer is created, only styles changed
+// by overrides are put together while rendering.
+
+struct compiled_palette {
+  const struct palette *palette;
+  size_t size;
+  struct string_view *begin; // Sequence starting each style of the palette
+  struct string_view *text; // Each style applied to a fixed text, if any
+};
+
+struct renderer {
+  struct terminal *terminal;
+  const struct config *config;
+  struct compiled_palette path;
+  struct compiled_palette separator;
+  struct string_view end; // Sequence ending any style
+  const char *home; // NULL unless paths are compacted
+  size_t home_length;
+  size_t separator_length;
+  bool reusable; // Whether output can be reused between paths
+  struct ls_colors *ls_colors; // NULL unless styling files by LS_COLORS
+};
+
+// Position in a path right after a separator, and the output rendered up to
+// there
+struct mark {
+  size_t path_offset;
+  size_t output_offset;
+  size_t path_index;
+  size_t separator_index;
+};
+
+// Consecutive paths, such as sorted lines of a stream, often share leading
+// directories. The output of the previous path is kept together with a mark
+// for each of its separators, and the output for a shared prefix is copied
+// instead of being rendered again. When paths keep sharing nothing, keeping
+// the output is only tried again after a while.
+enum {
+  REUSE_MISS_LIMIT = 16, // Paths without a shared prefix before backing off
+  REUSE_BACKOFF = 64 // Paths rendered without keeping the output
+};
+
+struct render_cache {
+  struct arena *arena;
+  struct intern_table *names; // Styles selected by hash for component names
+  bool valid; // Whether there is a previous path
+  bool compacted;
+  size_t segment_count;
+  size_t separator_count;
+  struct bytes *path; // Previous path after compacting and stripping
+  struct bytes *output;
+  struct vector *marks; // Of struct mark
+  size_t misses; // Consecutive paths sharing no prefix with the previous one
+  size_t backoff; // Paths left to render without keeping the output
+  size_t reused_paths;
+};
+
+// Styles changed by overrides are put together while rendering, possibly on
+// several threads at once. The terminal is not safe to use concurrently with
+// curses, which expands sequences into shared buffers.
+static pthread_mutex_t terminal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Position within the path being rendered
+struct cursor {
+  size_t path_index;
+  size_t separator_index;
+  size_t segment_count;
+  size_t separator_count;
+};
+
+static void begin_style(struct terminal *terminal,
+                        struct bytes *out,
+                        const struct style *style,
+                        bool bash_escape) {
+  if (bash_escape) {
+    bytes_append(out, "\\[", 2);
+  }
+  if (bool_attr_enabled(&style->bold)) {
+    terminal_bold(terminal, out);
+  }
+  if (bool_attr_enabled(&style->dim)) {
+    terminal_dim(terminal, out);
+  }
+  if (bool_attr_enabled(&style->underlined)) {
+    terminal_underlined(terminal, out);
+  }
+  if (bool_attr_enabled(&style->blink)) {
+    terminal_blink(terminal, out);
+  }
+  if (style->bg.state == ATTR_STATE_SET) {
+    terminal_bg(terminal, out, style->bg.value);
+  }
+  if (style->fg.state == ATTR_STATE_SET) {
+    terminal_fg(terminal, out, style->fg.value);
+  }
+  if (bash_escape) {
+    bytes_append(out, "\\]", 2);
+  }
+}
+
+static void end_style(struct terminal *terminal, struct bytes *out, bool bash_escape) {
+  if (bash_escape) {
+    bytes_append(out, "\\[", 2);
+  }
+  terminal_reset_style(terminal, out);
+  if (bash_escape) {
+    bytes_append(out, "\\]", 2);
+  }
+}
+
+static void merge_color_attr(const struct color_attr *lower,
+                             const struct color_attr *upper,
+                             struct color_attr *result) {
+  result->state = lower->state;
+  result->value = lower->value;
+  switch (upper->state){
+  case ATTR_STATE_UNSET:
+    break;
+  case ATTR_STATE_SET:
+    result->state = ATTR_STATE_SET;
+    result->value = upper->value;
+    break;
+  case ATTR_STATE_REVERTED:
+    result->state = ATTR_STATE_UNSET;
+    break;
+  }
+}
+
+static void merge_bool_attr(const struct bool_attr *lower,
+                            const struct bool_attr *upper,
+                            struct bool_attr *result) {
+  result->state = lower->state;
+  result->value = lower->value;
+  switch (upper->state){
+  case ATTR_STATE_UNSET:
+    break;
+  case ATTR_STATE_SET:
+    result->state = ATTR_STATE_SET;
+    result->value = upper->value;
+    break;
+  case ATTR_STATE_REVERTED:
+    result->state = ATTR_STATE_UNSET;
+    break;
+  }
+}
+
+static void merge_styles(const struct style *lower,
+                         const struct style *upper,
+                         struct style *result) {
+  merge_color_attr(&lower->fg, &upper->fg, &result->fg);
+  merge_color_attr(&lower->bg, &upper->bg, &result->bg);
+  merge_bool_attr(&lower->bold, &upper->bold, &result->bold);
+  merge_bool_attr(&lower->dim, &upper->dim, &result->dim);
+  merge_bool_attr(&lower->underlined, &upper->underlined, &result->underlined);
+  merge_bool_attr(&lower->blink, &upper->blink, &result->blink);
+}
+
+static struct string_view bytes_view(const struct bytes *bytes) {
+  return (struct string_view){ bytes_data(bytes), bytes_size(bytes) };
+}
+
+// Produce the sequences for each style of palette. When text is given, the
+// whole styled text is produced as well.
+static void compile_palette(struct arena *arena,
+                            struct terminal *terminal,
+                            const struct palette *palette,
+                            bool bash_escape,
+                            const char *text,
+                            struct compiled_palette *compiled) {
+  size_t size = palette_size(palette);
+  compiled->palette = palette;
+  compiled->size = size;
+  compiled->begin = arena_calloc(arena, size, sizeof(*compiled->begin));
+  compiled->text = text ? arena_calloc(arena, size, sizeof(*compiled->text)) : NULL;
+  for (size_t i = 0; i < size; i++) {
+    struct bytes *sequence = bytes_create(arena);
+    begin_style(terminal, sequence, palette_get(palette, i), bash_escape);
+    compiled->begin[i] = bytes_view(sequence);
+    if (text) {
+      struct bytes *styled = bytes_create(arena);
+      bytes_append(styled, compiled->begin[i].data, compiled->begin[i].length);
+      bytes_append(styled, text, strlen(text));
+      end_style(terminal, styled, bash_escape);
+      compiled->text[i] = bytes_view(styled);
+    }
+  }
+}
+
+struct renderer *renderer_create(struct arena *arena,
+                                 struct terminal *terminal,
+                                 const struct config *config) {
+  struct renderer *renderer = arena_alloc(arena, sizeof(*renderer));
+  renderer->terminal = terminal;
+  renderer->config = config;
+  renderer->home = NULL;
+  renderer->home_length = 0;
+  if (config->compact) {
+    renderer->home = get_home_directory();
+    if (!renderer->home) {
+      fputs("Failed to get home directory\n", stderr);
+      return NULL;
+    }
+    renderer->home_length = strlen(renderer->home);
+  }
+  renderer->separator_length = strlen(config->separator);
+  renderer->ls_colors = NULL;
+  if (config->ls_colors) {
+    const char *spec = get_env("LS_COLORS");
+    if (spec && *spec) {
+      renderer->ls_colors = ls_colors_parse(arena, spec, config->bash_escape);
+    }
+  }
+  // Random selection gives each element a new style every time
+  renderer->reusable = config->path_indexer != index_random
+    && config->separator_indexer != index_random;
+  compile_palette(arena,
+                  terminal,
+                  config_path_palette(terminal, config),
+                  config->bash_escape,
+                  NULL,
+                  &renderer->path);
+  compile_palette(arena,
+                  terminal,
+                  config_separator_palette(terminal, config),
+                  config->bash_escape,
+                  config->separator,
+                  &renderer->separator);
+  struct bytes *end = bytes_create(arena);
+  end_style(terminal, end, config->bash_escape);
+  renderer->end = bytes_view(end);
+  // Indexers set up their state on first use, which must not happen on
+  // several threads at once
+  config->path_indexer(1, 0, "", "");
+  config->separator_indexer(1, 0, "", "");
+  return renderer;
+}
+
+// Whether paths can be rendered on several threads at once. Random selection
+// shares one generator that is not safe to use concurrently.
+bool renderer_concurrent(const struct renderer *renderer) {
+  const struct config *config = renderer->config;
+  return config->path_indexer != index_random
+    && config->separator_indexer != index_random;
+}
+
+struct render_cache *render_cache_create(void) {
+  struct render_cache *cache = check(malloc(sizeof(*cache)));
+  cache->arena = arena_create();
+  cache->names = intern_table_create();
+  cache->valid = false;
+  cache->compacted = false;
+  cache->segment_count = 0;
+  cache->separator_count = 0;
+  cache->path = bytes_create(cache->arena);
+  cache->output = bytes_create(cache->arena);
+  cache->marks = vector_create(cache->arena, sizeof(struct mark));
+  cache->misses = 0;
+  cache->backoff = 0;
+  cache->reused_paths = 0;
+  return cache;
+}
+
+// Add the counters of cache to stats
+void render_cache_stats(const struct render_cache *cache, struct render_stats *stats) {
+  stats->name_hits += cache->names->hits;
+  stats->name_misses += cache->names->misses;
+  stats->reused_paths += cache->reused_paths;
+}
+
+void render_cache_free(struct render_cache *cache) {
+  intern_table_free(cache->names);
+  arena_free(cache->arena);
+  free(cache);
+}
+
+// Select the style for a path element. Styles selected by hash are kept in
+// names, so that repeated names are not hashed again.
+static size_t select_style(const struct compiled_palette *palette,
+                           struct intern_table *names,
+                           indexer_t indexer,
+                           size_t index,
+                           const char *start,
+                           const char *end) {
+  // Sequential selection is the common case and does not need a call
+  if (indexer == index_sequential) {
+    return index % palette->size;
+  }
+  struct intern_key key;
+  if (names && indexer == index_hash && intern_key_init(&key, start, end - start)) {
+    size_t *selected = intern_table_find(names, &key);
+    if (!selected) {
+      selected = intern_table_add(names, &key);
+      *selected = indexer(palette->size, index, start, end);
+    }
+    return *selected;
+  }
+  return indexer(palette->size, index, start, end);
+}
+
+// Append the text of a path element wrapped in the style selected for it.
+// The sequence given as extra, if any, is applied on top of that style.
+static void render_element(const struct renderer *renderer,
+                           struct bytes *out,
+                           struct intern_table *names,
+                           const struct compiled_palette *palette,
+                           const struct vector *overrides,
+                           indexer_t indexer,
+                           size_t index,
+                           size_t element_count,
+                           const char *start,
+                           const char *end,
+                           const char *text,
+                           size_t text_length,
+                           const struct string_view *extra) {
+  size_t selected = select_style(palette, names, indexer, index, start, end);
+  const struct style *style = palette_get(palette->palette, selected);
+  struct style tmp;
+  bool merged = false;
+  const struct override *override = overrides->data;
+  for (size_t i = 0; i < vector_size(overrides); i++, override++) {
+    if (override_index(override, element_count) == index) {
+      merge_styles(merged ? &tmp : style, override->style, &tmp);
+      merged = true;
+    }
+  }
+  if (merged) {
+    pthread_mutex_lock(&terminal_lock);
+    begin_style(renderer->terminal, out, &tmp, renderer->config->bash_escape);
+    pthread_mutex_unlock(&terminal_lock);
+    if (extra) {
+      bytes_append(out, extra->data, extra->length);
+    }
+    bytes_append(out, text, text_length);
+    bytes_append(out, renderer->end.data, renderer->end.length);
+    return;
+  }
+  if (palette->text && !extra) {
+    bytes_append(out, palette->text[selected].data, palette->text[selected].length);
+    return;
+  }
+  const struct string_view *begin = &palette->begin[selected];
+  if (extra) {
+    bytes_append(out, begin->data, begin->length);
+    begin = extra;
+  }
+  char *pos = bytes_extend(out, begin->length + text_length + renderer->end.length);
+  memcpy(pos, begin->data, begin->length);
+  memcpy(pos + begin->length, text, text_length);
+  memcpy(pos + begin->length + text_length, renderer->end.data, renderer->end.length);
+}
+
+static void render_segment(const struct renderer *renderer,
+                           struct render_cache *cache,
+                           struct bytes *out,
+                           struct cursor *cursor,
+                           const char *start,
+                           const char *end,
+                           const struct string_view *extra) {
+  const struct config *config = renderer->config;
+  render_element(renderer,
+                 out,
+                 cache ? cache->names : NULL,
+                 &renderer->path,
+                 config->path_overrides,
+                 config->path_indexer,
+                 cursor->path_index,
+                 cursor->segment_count,
+                 start,
+                 end,
+                 start,
+                 end - start,
+                 extra);
+  cursor->path_index++;
+}
+
+static void render_separator(const struct renderer *renderer,
+                             struct bytes *out,
+                             struct cursor *cursor,
+                             const char *sep) {
+  const struct config *config = renderer->config;
+  render_element(renderer,
+                 out,
+                 NULL,
+                 &renderer->separator,
+                 config->separator_overrides,
+                 config->separator_indexer,
+                 cursor->separator_index,
+                 cursor->separator_count,
+                 sep,
+                 sep + 1,
+                 config->separator,
+                 renderer->separator_length,
+                 NULL);
+  cursor->separator_index++;
+}
+
+static void count_components(const char *path,
+                             const char *end,
+                             struct cursor *cursor) {
+  const char *sep;
+  while ((sep = memchr(path, '/', end - path))) {
+    if (sep != path) {
+      cursor->segment_count++;
+    }
+    cursor->separator_count++;
+    path = sep + 1;
+  }
+  if (path < end) {
+    cursor->segment_count++;
+  }
+}
+
+// Whether overrides select the same elements of paths with either count
+static bool same_overrides(const struct vector *overrides, size_t previous, size_t current) {
+  if (previous == current) {
+    return true;
+  }
+  if (!previous || !current) {
+    return !vector_size(overrides);
+  }
+  const struct override *override = overrides->data;
+  for (size_t i = 0; i < vector_size(overrides); i++, override++) {
+    if (override_index(override, previous) != override_index(override, current)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static size_t common_prefix(const char *a, const char *b, size_t length) {
+  size_t i = 0;
+  uint64_t a_word;
+  uint64_t b_word;
+  for (; i + sizeof(a_word) <= length; i += sizeof(a_word)) {
+    memcpy(&a_word, a + i, sizeof(a_word));
+    memcpy(&b_word, b + i, sizeof(b_word));
+    if (a_word != b_word) {
+      break;
+    }
+  }
+  for (; i < length && a[i] == b[i]; i++);
+  return i;
+}
+
+// Copy the output for the leading directories path shares with the previous
+// path and move the cursor past them. Returns the position to continue
+// rendering from.
+static const char *reuse_prefix(const struct renderer *renderer,
+                                struct render_cache *cache,
+                                struct bytes *out,
+                                struct cursor *cursor,
+                                const char *path,
+                                const char *end,
+                                bool compacted) {
+  const struct config *config = renderer->config;
+  if (!cache->valid
+      || cache->compacted != compacted
+      || !same_overrides(config->path_overrides, cache->segment_count, cursor->segment_count)
+      || !same_overrides(config->separator_overrides,
+                         cache->separator_count,
+                         cursor->separator_count)) {
+    vector_truncate(cache->marks, 0);
+    return path;
+  }
+  size_t previous_length = bytes_size(cache->path);
+  size_t length = end - path;
+  size_t common = common_prefix(bytes_data(cache->path),
+                                path,
+                                previous_length < length ? previous_length : length);
+  const struct mark *marks = cache->marks->data;
+  size_t count = vector_size(cache->marks);
+  for (; count && marks[count - 1].path_offset > common; count--);
+  vector_truncate(cache->marks, count);
+  // Sharing only leading separators saves too little to count
+  if (count && marks[count - 1].path_index) {
+    cache->misses = 0;
+    cache->reused_paths++;
+  } else if (++cache->misses == REUSE_MISS_LIMIT) {
+    cache->backoff = REUSE_BACKOFF;
+    // A single miss after backing off is enough to back off again
+    cache->misses--;
+  }
+  if (!count) {
+    return path;
+  }
+  const struct mark *mark = &marks[count - 1];
+  bytes_append(out, bytes_data(cache->output), mark->output_offset);
+  cursor->path_index = mark->path_index;
+  cursor->separator_index = mark->separator_index;
+  return path + mark->path_offset;
+}
+
+// Length of the home directory at the start of path, or zero if paths are
+// not compacted or path is not within the home directory
+size_t render_home_prefix(const struct renderer *renderer, const char *path, size_t length) {
+  if (renderer->home
+      && length >= renderer->home_length
+      && !memcmp(path, renderer->home, renderer->home_length)
+      && (length == renderer->home_length || path[renderer->home_length] == '/')) {
+    return renderer->home_length;
+  }
+  return 0;
+}
+
+// Append path to out. The home directory is replaced with ~ when compacting
+// and leading separators are left out when stripping them. When a cache is
+// given, output is reused from the previous path rendered with it.
+void render_path(const struct renderer *renderer,
+                 struct render_cache *cache,
+                 struct bytes *out,
+                 const char *path,
+                 size_t length) {
+  const struct config *config = renderer->config;
+  const char *full_path = path;
+  const char *end = path + length;
+  size_t home_length = render_home_prefix(renderer, path, length);
+  bool compacted = home_length != 0;
+  path += home_length;
+  if (config->strip_leading && !compacted) {
+    for (; path < end && *path == '/'; path++);
+  }
+
+  struct cursor cursor = { 0 };
+  // Element counts are only needed for resolving override indices
+  if (vector_size(config->path_overrides) || vector_size(config->separator_overrides)) {
+    count_components(path, end, &cursor);
+    if (compacted) {
+      cursor.segment_count++;
+    }
+  }
+
+  bool reusing = cache && renderer->reusable;
+  if (reusing && cache->backoff) {
+    cache->backoff--;
+    cache->valid = false;
+    reusing = false;
+  }
+  // The last component is styled by LS_COLORS on top of the palette. Output
+  // after it cannot be shared with other paths.
+  const struct string_view *file_style = NULL;
+  const char *file_name = end;
+  if (renderer->ls_colors) {
+    const char *name_end = end;
+    for (; name_end > path && name_end[-1] == '/'; name_end--);
+    const char *name = name_end;
+    for (; name > path && name[-1] != '/'; name--);
+    if (name < name_end) {
+      file_style = ls_colors_find(renderer->ls_colors,
+                                  full_path,
+                                  length,
+                                  name,
+                                  name_end - name,
+                                  name_end < end);
+      file_name = file_style ? name : end;
+    }
+  }
+
+  const char *start = path;
+  size_t output_start = bytes_size(out);
+  if (reusing) {
+    path = reuse_prefix(renderer, cache, out, &cursor, path, file_name, compacted);
+  }
+  if (compacted && path == start) {
+    static const char HOME[] = "~";
+    render_segment(renderer, cache, out, &cursor, HOME, HOME + 1, NULL);
+  }
+  const char *sep;
+  while ((sep = memchr(path, '/', end - path))) {
+    if (sep != path) {
+      render_segment(renderer, cache, out, &cursor, path, sep, path == file_name ? file_style : NULL);
+    }
+    render_separator(renderer, out, &cursor, sep);
+    path = sep + 1;
+    if (reusing && path <= file_name) {
+      struct mark *mark = vector_push(cache->marks);
+      mark->path_offset = path - start;
+      mark->output_offset = bytes_size(out) - output_start;
+      mark->path_index = cursor.path_index;
+      mark->separator_index = cursor.separator_index;
+    }
+  }
+  if (path < end) {
+    render_segment(renderer, cache, out, &cursor, path, end, path == file_name ? file_style : NULL);
+  }
+
+  if (reusing) {
+    cache->valid = true;
+    cache->compacted = compacted;
+    cache->segment_count = cursor.segment_count;
+    cache->separator_count = cursor.separator_count;
+    bytes_clear(cache->path);
+    bytes_append(cache->path, start, end - start);
+    bytes_clear(cache->output);
+    bytes_append(cache->output, bytes_data(out) + output_start, bytes_size(out) - output_start);
+  }
+}
+
+// Classes of bytes in paths found within text. Whitespace, quotes, brackets,
+// the colons before line numbers and other punctuation that surrounds paths
+// end them. Only paths with some letter in them are highlighted, so that
+// dates and fractions are left alone.
+enum {
+  TEXT_OTHER = 0,
+  TEXT_PATH, // Digits and punctuation of paths
+  TEXT_NAME // Letters and other bytes of names
+};
+
+static const unsigned char TEXT_CLASS[256] = {
+  ['/'] = TEXT_PATH,
+  ['.'] = TEXT_PATH,
+  ['-'] = TEXT_PATH,
+  ['+'] = TEXT_PATH,
+  ['0' ... '9'] = TEXT_PATH,
+  ['a' ... 'z'] = TEXT_NAME,
+  ['A' ... 'Z'] = TEXT_NAME,
+  ['_'] = TEXT_NAME,
+  ['~'] = TEXT_NAME,
+  ['@'] = TEXT_NAME,
+  [0x80 ... 0xff] = TEXT_NAME
+};
+
+// Find the path around the separator at slash, not reaching back before
+// start. Returns false if the text around it does not look like a path.
+static bool find_text_path(const char *start,
+                           const char *slash,
+                           const char *end,
+                           const char **path,
+                           const char **path_end) {
+  const char *begin = slash;
+  while (begin > start && TEXT_CLASS[(unsigned char)begin[-1]]) {
+    begin--;
+  }
+  const char *stop = slash + 1;
+  while (stop < end && TEXT_CLASS[(unsigned char)*stop]) {
+    stop++;
+  }
+  // A full stop ending a sentence is not part of the path
+  if (stop - begin >= 2 && stop[-1] == '.' && stop[-2] != '.' && stop[-2] != '/') {
+    stop--;
+  }
+  *path = begin;
+  *path_end = stop;
+  // The scheme of a URL ends at the colon before the two slashes
+  if (begin > start && begin[-1] == ':' && stop - begin >= 2 && begin[1] == '/' && *begin == '/') {
+    return false;
+  }
+  for (const char *pos = begin; pos < stop; pos++) {
+    if (TEXT_CLASS[(unsigned char)*pos] == TEXT_NAME) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Append text with the paths in it rendered and all other bytes unchanged.
+// Paths are only looked for around separators, which are found with memchr,
+// so text without any is copied at once.
+static void render_text(const struct renderer *renderer,
+                        struct render_cache *cache,
+                        struct bytes *out,
+                        const char *text,
+                        size_t length) {
+  const char *end = text + length;
+  const char *copied = text; // Text before this has been appended
+  const char *pos = text;
+  const char *slash;
+  while ((slash = memchr(pos, '/', end - pos))) {
+    const char *path;
+    const char *path_end;
+    if (find_text_path(pos, slash, end, &path, &path_end)) {
+      bytes_append(out, copied, path - copied);
+      render_path(renderer, cache, out, path, path_end - path);
+      copied = path_end;
+    }
+    pos = path_end;
+  }
+  bytes_append(out, copied, end - copied);
+}
+
+static inline bool is_blank(char c) {
+  return c == ' ' || c == '\t';
+}
+
+// Find the first space or tab, checking eight bytes at a time for either
+static const char *find_blank(const char *pos, const char *end) {
+  const uint64_t ones = UINT64_C(0x0101010101010101);
+  const uint64_t highs = UINT64_C(0x8080808080808080);
+  for (; end - pos >= 8; pos += 8) {
+    uint64_t word;
+    memcpy(&word, pos, sizeof(word));
+    uint64_t spaces = word ^ (ones * ' ');
+    uint64_t tabs = word ^ (ones * '\t');
+    if (((spaces - ones) & ~spaces & highs) | ((tabs - ones) & ~tabs & highs)) {
+      break;
+    }
+  }
+  for (; pos < end && !is_blank(*pos); pos++);
+  return pos;
+}
+
+// Find the field of a record selected with --field. Fields are separated by
+// the field delimiter, or by runs of blanks with leading blanks ignored.
+// Returns false if the record has fewer fields.
+static bool find_field(const struct config *config,
+                       const char *record,
+                       const char *end,
+                       const char **start,
+                       const char **stop) {
+  const char *pos = record;
+  if (config->field_delimiter == FIELD_BLANKS) {
+    for (size_t field = 1; ; field++) {
+      for (; pos < end && is_blank(*pos); pos++);
+      if (pos == end) {
+        return false;
+      }
+      const char *field_end = find_blank(pos, end);
+      if (field == config->record_field) {
+        *start = pos;
+        *stop = field_end;
+        return true;
+      }
+      pos = field_end;
+    }
+  }
+  for (size_t field = 1; field < config->record_field; field++) {
+    const char *delim = memchr(pos, config->field_delimiter, end - pos);
+    if (!delim) {
+      return false;
+    }
+    pos = delim + 1;
+  }
+  const char *delim = memchr(pos, config->field_delimiter, end - pos);
+  *start = pos;
+  *stop = delim ? delim : end;
+  return true;
+}
+
+// Append a record read from input, either a path or text with paths in it.
+// When a field is selected, only that field is rendered and the rest of the
+// record is copied unchanged, as are records without the field.
+void render_record(const struct renderer *renderer,
+                   struct render_cache *cache,
+                   struct bytes *out,
+                   const char *record,
+                   size_t length) {
+  const struct config *config = renderer->config;
+  const char *end = record + length;
+  const char *start = record;
+  const char *stop = end;
+  if (config->record_field && !find_field(config, record, end, &start, &stop)) {
+    bytes_append(out, record, length);
+    return;
+  }
+  bytes_append(out, record, start - record);
+  if (config->highlight_paths) {
+    render_text(renderer, cache, out, start, stop - start);
+  } else {
+    render_path(renderer, cache, out, start, stop - start);
+  }
+  bytes_append(out, stop, end - stop);
+}
+
+// Append a single name shown at the given depth of a tree. The name is styled
+// as the last component of a path with depth components before it.
+void render_tree_name(const struct renderer *renderer,
+                      struct bytes *out,
+                      const char *name,
+                      size_t length,
+                      size_t depth) {
+  const struct config *config = renderer->config;
+  render_element(renderer,
+                 out,
+                 NULL,
+                 &renderer->path,
+                 config->path_overrides,
+                 config->path_indexer,
+                 depth,
+                 depth + 1,
+                 name,
+                 name + length,
+                 name,
+                 length,
+                 NULL);
+}
+
+// Append the root of a tree of absolute paths, styled as a leading separator
+void render_tree_root(const struct renderer *renderer, struct bytes *out) {
+  static const char ROOT[] = "/";
+  const struct config *config = renderer->config;
+  render_element(renderer,
+                 out,
+                 NULL,
+                 &renderer->separator,
+                 config->separator_overrides,
+                 config->separator_indexer,
+                 0,
+                 1,
+                 ROOT,
+                 ROOT + 1,
+                 config->separator,
+                 renderer->separator_length,
+                 NULL);
+}
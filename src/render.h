@@ -0,0 +1,47 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "bytes.h"
+#include "config.h"
+#include "terminal.h"
+
+struct renderer;
+struct render_cache;
+
+// Counters collected from render caches
+struct render_stats {
+  size_t name_hits; // Component names whose style was already known
+  size_t name_misses;
+  size_t reused_paths; // Paths that reused output of the previous path
+};
+
+struct renderer *renderer_create(struct arena *arena,
+                                 struct terminal *terminal,
+                                 const struct config *config);
+struct render_cache *render_cache_create(void);
+void render_cache_stats(const struct render_cache *cache, struct render_stats *stats);
+void render_cache_free(struct render_cache *cache);
+void render_path(const struct renderer *renderer,
+                 struct render_cache *cache,
+                 struct bytes *out,
+                 const char *path,
+                 size_t length);
+void render_record(const struct renderer *renderer,
+                   struct render_cache *cache,
+                   struct bytes *out,
+                   const char *record,
+                   size_t length);
+size_t render_home_prefix(const struct renderer *renderer, const char *path, size_t length);
+void render_tree_name(const struct renderer *renderer,
+                      struct bytes *out,
+                      const char *name,
+                      size_t length,
+                      size_t depth);
+void render_tree_root(const struct renderer *renderer, struct bytes *out);
+bool renderer_concurrent(const struct renderer *renderer);
+
+#endif
@@ -0,0 +1,451 @@
+#include "build.h"
+
+#include "stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bytes.h"
+#include "queue.h"
+#include "utils.h"
+
+// Paths are read into fixed buffers and rendered into output buffers that are
+// written out as they fill up. Records longer than an input buffer cannot be
+// paths and are copied to the output unchanged, so memory use does not depend
+// on the input.
+//
+// With more than one job, rendering runs as a pipeline. The calling thread
+// reads the input into chunks that end at a delimiter and hands them to the
+// workers in turn. Each worker renders its chunks into their own output
+// buffers, and a writer thread collects the chunks from the workers in the
+// same order. Chunks come from a fixed pool that the writer returns them to,
+// which bounds the memory in use.
+//
+// Output is held back only while more input is ready to be read, so that
+// bulk input is written in large blocks while the output of a live stream,
+// such as a log followed with tail -f, appears as soon as its input does.
+// With a maximum latency, output is not held back for longer than that even
+// when input keeps arriving.
+//
+// Regular files rendered on one thread are mapped into memory instead, and
+// paths are rendered straight from the mapping. Pages behind the current
+// position are released as rendering advances, so large files do not stay
+// resident.
+
+enum {
+  STREAM_BUFFER_SIZE = 256 * 1024,
+  OUTPUT_BUFFER_SIZE = 256 * 1024,
+  CHUNKS_PER_JOB = 4,
+  RELEASE_INTERVAL = 8 * 1024 * 1024 // Mapped bytes rendered between releases
+};
+
+struct stream {
+  const struct renderer *renderer;
+  int in;
+  int out;
+  char delimiter;
+  const struct string_view *terminator;
+  uint64_t max_latency; // Nanoseconds, zero if there is no bound
+  struct render_stats *stats;
+};
+
+struct chunk {
+  char *input;
+  size_t length;
+  bool copying; // Whether the chunk starts within a record copied as is
+  struct bytes *output;
+};
+
+struct worker {
+  pthread_t thread;
+  const struct stream *stream;
+  struct render_cache *cache;
+  struct queue *input; // Chunks to render, NULL when the input ends
+  struct queue *output; // Rendered chunks
+};
+
+struct writer {
+  pthread_t thread;
+  const struct stream *stream;
+  struct worker *workers;
+  size_t jobs;
+  struct queue *free_chunks;
+  atomic_bool failed;
+};
+
+static bool flush_output(int fd, struct bytes *output) {
+  bool written = write_all(fd, bytes_data(output), bytes_size(output));
+  bytes_clear(output);
+  return written;
+}
+
+// Whether the input has data that can be read without blocking
+static bool input_ready(int fd) {
+  struct pollfd pollfd = { .fd = fd, .events = POLLIN };
+  return poll(&pollfd, 1, 0) > 0;
+}
+
+static uint64_t monotonic_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Whether to hold back rendered output to read more input first. held_since
+// is when output was first held back, zero if it was not.
+static bool hold_output(const struct stream *stream, uint64_t *held_since) {
+  if (!input_ready(stream->in)) {
+    return false;
+  }
+  if (stream->max_latency) {
+    uint64_t now = monotonic_ns();
+    if (!*held_since) {
+      *held_since = now;
+    } else if (now - *held_since >= stream->max_latency) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Render the records delimited between pos and end. While copying is set, the
+// first record is copied unchanged instead. Returns the start of the trailing
+// data that is not followed by a delimiter.
+static const char *render_records(const struct stream *stream,
+                                  struct render_cache *cache,
+                                  struct bytes *output,
+                                  const char *pos,
+                                  const char *end,
+                                  bool *copying) {
+  const char *delim;
+  while ((delim = memchr(pos, stream->delimiter, end - pos))) {
+    if (*copying) {
+      bytes_append(output, pos, delim - pos);
+      *copying = false;
+    } else {
+      render_record(stream->renderer, cache, output, pos, delim - pos);
+    }
+    bytes_append(output, stream->terminator->data, stream->terminator->length);
+    pos = delim + 1;
+  }
+  return pos;
+}
+
+// Render data that is not followed by a delimiter
+static void render_rest(const struct stream *stream,
+                        struct render_cache *cache,
+                        struct bytes *output,
+                        const char *pos,
+                        const char *end,
+                        bool copying) {
+  if (copying) {
+    bytes_append(output, pos, end - pos);
+  } else if (pos < end) {
+    render_record(stream->renderer, cache, output, pos, end - pos);
+  }
+}
+
+static bool render_serial(const struct stream *stream) {
+  bool ret = false;
+  char *buffer = check(malloc(STREAM_BUFFER_SIZE));
+  struct bytes *output = bytes_create(NULL);
+  struct render_cache *cache = render_cache_create();
+  size_t length = 0;
+  bool copying = false; // Whether the current record is being copied as is
+  uint64_t held_since = 0;
+  while (true) {
+    ssize_t count = read(stream->in, buffer + length, STREAM_BUFFER_SIZE - length);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      goto out;
+    }
+    length += count;
+    const char *end = buffer + length;
+    const char *pos = render_records(stream, cache, output, buffer, end, &copying);
+    length = end - pos;
+    if (count == 0) {
+      render_rest(stream, cache, output, pos, end, copying);
+      break;
+    }
+    if (length == STREAM_BUFFER_SIZE) {
+      render_rest(stream, cache, output, pos, end, true);
+      copying = true;
+      length = 0;
+    } else {
+      memmove(buffer, pos, length);
+    }
+    if (bytes_size(output) >= OUTPUT_BUFFER_SIZE
+        || (bytes_size(output) && !hold_output(stream, &held_since))) {
+      if (!flush_output(stream->out, output)) {
+        goto out;
+      }
+      held_since = 0;
+    }
+  }
+  ret = flush_output(stream->out, output);
+ out:
+  render_cache_stats(cache, stream->stats);
+  render_cache_free(cache);
+  bytes_free(output);
+  free(buffer);
+  return ret;
+}
+
+static void *worker_main(void *arg) {
+  struct worker *worker = arg;
+  struct chunk *chunk;
+  while ((chunk = queue_pop(worker->input))) {
+    bytes_clear(chunk->output);
+    const char *end = chunk->input + chunk->length;
+    bool copying = chunk->copying;
+    const char *pos = render_records(worker->stream,
+                                     worker->cache,
+                                     chunk->output,
+                                     chunk->input,
+                                     end,
+                                     &copying);
+    render_rest(worker->stream, worker->cache, chunk->output, pos, end, copying);
+    queue_push(worker->output, chunk);
+  }
+  queue_push(worker->output, NULL);
+  return NULL;
+}
+
+static void *writer_main(void *arg) {
+  struct writer *writer = arg;
+  struct chunk *chunk;
+  for (size_t i = 0; (chunk = queue_pop(writer->workers[i].output)); i = (i + 1) % writer->jobs) {
+    // Chunks keep flowing after a failure so that the reader can finish
+    if (!atomic_load(&writer->failed)
+        && !write_all(writer->stream->out, bytes_data(chunk->output), bytes_size(chunk->output))) {
+      atomic_store(&writer->failed, true);
+    }
+    queue_push(writer->free_chunks, chunk);
+  }
+  return NULL;
+}
+
+// Read the input into chunks for the workers. Returns false if reading
+// fails.
+static bool read_chunks(const struct stream *stream, struct writer *writer) {
+  struct worker *workers = writer->workers;
+  size_t next = 0; // Worker receiving the next chunk
+  struct chunk *chunk = queue_pop(writer->free_chunks);
+  size_t length = 0;
+  bool copying = false; // Whether the current record is being copied as is
+  uint64_t held_since = 0;
+  while (!atomic_load(&writer->failed)) {
+    ssize_t count = read(stream->in, chunk->input + length, STREAM_BUFFER_SIZE - length);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    length += count;
+    if (count == 0) {
+      if (length) {
+        chunk->length = length;
+        chunk->copying = copying;
+        queue_push(workers[next].input, chunk);
+      }
+      break;
+    }
+    const char *last = memrchr(chunk->input, stream->delimiter, length);
+    if (length < STREAM_BUFFER_SIZE && (!last || hold_output(stream, &held_since))) {
+      continue;
+    }
+    held_since = 0;
+    // Records that do not fit into a chunk are copied as is, just like when
+    // rendering without a pipeline
+    size_t used = last ? (size_t)(last + 1 - chunk->input) : length;
+    struct chunk *next_chunk = queue_pop(writer->free_chunks);
+    memcpy(next_chunk->input, chunk->input + used, length - used);
+    chunk->length = used;
+    chunk->copying = last ? copying : true;
+    queue_push(workers[next].input, chunk);
+    next = (next + 1) % writer->jobs;
+    copying = !last;
+    length -= used;
+    chunk = next_chunk;
+  }
+  return true;
+}
+
+static bool render_parallel(const struct stream *stream, size_t jobs) {
+  size_t chunk_count = jobs * CHUNKS_PER_JOB;
+  struct chunk *chunks = check(calloc(chunk_count, sizeof(*chunks)));
+  struct writer writer = {
+    .stream = stream,
+    .workers = check(calloc(jobs, sizeof(*writer.workers))),
+    .jobs = 0,
+    .free_chunks = queue_create(chunk_count),
+  };
+  atomic_init(&writer.failed, false);
+  for (size_t i = 0; i < chunk_count; i++) {
+    chunks[i].input = check(malloc(STREAM_BUFFER_SIZE));
+    chunks[i].output = bytes_create(NULL);
+    queue_push(writer.free_chunks, &chunks[i]);
+  }
+  // Each queue has room for every chunk and the end of the input
+  for (; writer.jobs < jobs; writer.jobs++) {
+    struct worker *worker = &writer.workers[writer.jobs];
+    worker->stream = stream;
+    worker->cache = render_cache_create();
+    worker->input = queue_create(chunk_count + 1);
+    worker->output = queue_create(chunk_count + 1);
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+      render_cache_free(worker->cache);
+      queue_free(worker->input);
+      queue_free(worker->output);
+      break;
+    }
+  }
+
+  bool ret = false;
+  bool started = writer.jobs > 0
+    && pthread_create(&writer.thread, NULL, writer_main, &writer) == 0;
+  if (started) {
+    ret = read_chunks(stream, &writer);
+  }
+  for (size_t i = 0; i < writer.jobs; i++) {
+    queue_push(writer.workers[i].input, NULL);
+  }
+  for (size_t i = 0; i < writer.jobs; i++) {
+    pthread_join(writer.workers[i].thread, NULL);
+  }
+  if (started) {
+    pthread_join(writer.thread, NULL);
+    ret = ret && !atomic_load(&writer.failed);
+  } else {
+    // Without threads nothing has been read yet
+    ret = render_serial(stream);
+  }
+  for (size_t i = 0; i < writer.jobs; i++) {
+    render_cache_stats(writer.workers[i].cache, stream->stats);
+    render_cache_free(writer.workers[i].cache);
+    queue_free(writer.workers[i].input);
+    queue_free(writer.workers[i].output);
+  }
+
+  for (size_t i = 0; i < chunk_count; i++) {
+    free(chunks[i].input);
+    bytes_free(chunks[i].output);
+  }
+  queue_free(writer.free_chunks);
+  free(writer.workers);
+  free(chunks);
+  return ret;
+}
+
+static bool render_mapped(const struct stream *stream, const char *data, size_t length) {
+  bool ret = false;
+  struct bytes *output = bytes_create(NULL);
+  struct render_cache *cache = render_cache_create();
+  size_t page_size = getpagesize();
+  const char *pos = data;
+  const char *end = data + length;
+  const char *released = data; // Pages before this have been released
+  while (pos < end) {
+    const char *delim = memchr(pos, stream->delimiter, end - pos);
+    const char *record_end = delim ? delim : end;
+    // Same limit as when reading the records into a buffer
+    if (record_end - pos >= STREAM_BUFFER_SIZE) {
+      bytes_append(output, pos, record_end - pos);
+    } else {
+      render_record(stream->renderer, cache, output, pos, record_end - pos);
+    }
+    if (!delim) {
+      break;
+    }
+    bytes_append(output, stream->terminator->data, stream->terminator->length);
+    pos = delim + 1;
+    if (bytes_size(output) >= OUTPUT_BUFFER_SIZE && !flush_output(stream->out, output)) {
+      goto out;
+    }
+    if ((size_t)(pos - released) >= RELEASE_INTERVAL) {
+      const char *boundary = data + (pos - data) / page_size * page_size;
+      madvise((void *)released, boundary - released, MADV_DONTNEED);
+      released = boundary;
+    }
+  }
+  ret = flush_output(stream->out, output);
+ out:
+  render_cache_stats(cache, stream->stats);
+  render_cache_free(cache);
+  bytes_free(output);
+  return ret;
+}
+
+// Render every delimited record read from in as a path. Each rendered path is
+// followed by terminator, except for a final record without a delimiter. The
+// output is the same for any number of jobs. Renderers that cannot be shared
+// between threads always use one.
+bool render_stream(const struct renderer *renderer,
+                   int in,
+                   int out,
+                   char delimiter,
+                   const struct string_view *terminator,
+                   size_t jobs,
+                   uint64_t max_latency,
+                   struct render_stats *stats) {
+  const struct stream stream = {
+    .renderer = renderer,
+    .in = in,
+    .out = out,
+    .delimiter = delimiter,
+    .terminator = terminator,
+    .max_latency = max_latency,
+    .stats = stats,
+  };
+  if (jobs > 1 && renderer_concurrent(renderer)) {
+    return render_parallel(&stream, jobs);
+  }
+  return render_serial(&stream);
+}
+
+// Render the records of the file open as in like render_stream. Regular files
+// are mapped into memory when rendering on a single thread.
+bool render_file(const struct renderer *renderer,
+                 int in,
+                 int out,
+                 char delimiter,
+                 const struct string_view *terminator,
+                 size_t jobs,
+                 uint64_t max_latency,
+                 struct render_stats *stats) {
+  struct stat buf;
+  if ((jobs > 1 && renderer_concurrent(renderer))
+      || fstat(in, &buf) != 0
+      || !S_ISREG(buf.st_mode)
+      || buf.st_size == 0) {
+    return render_stream(renderer, in, out, delimiter, terminator, jobs, max_latency, stats);
+  }
+  void *data = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, in, 0);
+  if (data == MAP_FAILED) {
+    return render_stream(renderer, in, out, delimiter, terminator, jobs, max_latency, stats);
+  }
+  madvise(data, buf.st_size, MADV_SEQUENTIAL);
+  const struct stream stream = {
+    .renderer = renderer,
+    .in = in,
+    .out = out,
+    .delimiter = delimiter,
+    .terminator = terminator,
+    .max_latency = max_latency,
+    .stats = stats,
+  };
+  bool ret = render_mapped(&stream, data, buf.st_size);
+  munmap(data, buf.st_size);
+  return ret;
+}
@@ -0,0 +1,28 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parser_common.h"
+#include "render.h"
+
+bool render_stream(const struct renderer *renderer,
+                   int in,
+                   int out,
+                   char delimiter,
+                   const struct string_view *terminator,
+                   size_t jobs,
+                   uint64_t max_latency,
+                   struct render_stats *stats);
+bool render_file(const struct renderer *renderer,
+                 int in,
+                 int out,
+                 char delimiter,
+                 const struct string_view *terminator,
+                 size_t jobs,
+                 uint64_t max_latency,
+                 struct render_stats *stats);
+
+#endif
@@ -5,65 +5,50 @@
 
 #include "style_parser.h"
 #include "parser_common.h"
+#include "keywords.h"
 #include "bytes.h"
-#include "list.h"
 #include "utils.h"
 
 
-static bool parse_symbolic_color(const char *value, uint8_t *color) {
-  static const char *colors[] = {
-    "black",
-    "red",
-    "green",
-    "yellow",
-    "blue",
-    "magenta",
-    "cyan",
-    "white",
-  };
-  for (uint8_t i = 0; i < ARRAY_SIZE(colors); i++) {
-    if (!strcmp(colors[i], value)) {
-      *color = i;
-      return true;
-    }
+static bool parse_symbolic_color(const struct string_view *value, uint8_t *color) {
+  enum keyword keyword = keyword_lookup(value->data, value->length);
+  if (keyword < KEYWORD_BLACK || keyword > KEYWORD_WHITE) {
+    return false;
   }
-  return false;
+  *color = keyword - KEYWORD_BLACK;
+  return true;
 }
 
-static bool parse_numeric_color(const char *value, uint8_t *color) {
-  char *num_end;
-  unsigned long num = strtoul(value, &num_end, 10);
-  if (num == 0 && num_end == value) {
-    return false;
-  };
-  if (*num_end != '\0') {
-    return false;
-  }
-  if (num > (unsigned long)UINT8_MAX) {
-    parse_error("Color outside acceptable range");
-    return false;
+static bool parse_numeric_color(const struct string_view *value, uint8_t *color) {
+  unsigned long num = 0;
+  for (size_t i = 0; i < value->length; i++) {
+    char c = value->data[i];
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    num = num * 10 + (c - '0');
+    if (num > (unsigned long)UINT8_MAX) {
+      parse_error("Color outside acceptable range");
+      return false;
+    }
   }
   *color = (uint8_t)num;
   return true;
 }
 
 static const char *parse_color(const char *pos, const char *end, uint8_t *color) {
-  char *token;
+  struct string_view token;
   pos = parse_token(pos, end, &token);
   if (!pos) {
     return NULL;
   }
-  if (parse_symbolic_color(token, color)) {
-    goto out;
-  } else if (parse_numeric_color(token, color)) {
-    goto out;
-  } else {
-    parse_error("Invalid color");
-    pos = NULL;
+  if (parse_symbolic_color(&token, color)) {
+    return pos;
+  } else if (parse_numeric_color(&token, color)) {
+    return pos;
   }
-out:
-  free(token);
-  return pos;
+  parse_error("Invalid color");
+  return NULL;
 }
 
 static const char *parse_color_assignment(const char *pos, const char *end, struct color_attr *color_attr) {
@@ -88,47 +73,47 @@ static const char *parse_property(const char *pos, const char *end, struct style
     revert = true;
     pos = pos_;
   }
-  char *token;
+  struct string_view token;
   pos = parse_token(pos, end, &token);
   if (!pos) {
     return NULL;
   }
-  if (!strcmp(token, "fg")) {
+  switch (keyword_lookup(token.data, token.length)) {
+  case KEYWORD_FG:
     if (!revert) {
       pos = parse_color_assignment(pos, end, &style->fg);
-      if (!pos) {
-        goto out;
-      }
     } else {
       style->fg.state = ATTR_STATE_REVERTED;
     }
-  } else if (!strcmp(token, "bg")) {
+    break;
+  case KEYWORD_BG:
     if (!revert) {
       pos = parse_color_assignment(pos, end, &style->bg);
-      if (!pos) {
-        goto out;
-      }
     } else {
       style->bg.state = ATTR_STATE_REVERTED;
     }
-  } else if (!strcmp(token, "bold")) {
+    break;
+  case KEYWORD_BOLD:
     style->bold.state = revert ? ATTR_STATE_REVERTED : ATTR_STATE_SET;
     style->bold.value = true;
-  } else if (!strcmp(token, "dim")) {
+    break;
+  case KEYWORD_DIM:
     style->dim.state = revert ? ATTR_STATE_REVERTED : ATTR_STATE_SET;
     style->dim.value = true;
-  } else if (!strcmp(token, "underlined")) {
+    break;
+  case KEYWORD_UNDERLINED:
     style->underlined.state = revert ? ATTR_STATE_REVERTED : ATTR_STATE_SET;
     style->underlined.value = true;
-  } else if (!strcmp(token, "blink")) {
+    break;
+  case KEYWORD_BLINK:
     style->blink.state = revert ? ATTR_STATE_REVERTED : ATTR_STATE_SET;
     style->blink.value = true;
-  } else {
+    break;
+  default:
     parse_error("Unknown property");
     pos = NULL;
+    break;
   }
- out:
-  free(token);
   return pos;
 }
 
@@ -154,35 +139,32 @@ static const char *parse_style_inner(const char *pos, const char *end, struct st
   return pos;
 }
 
-const char *parse_style(const char *pos, const char *end, struct style **style) {
-  struct style *style_ = check(malloc(sizeof(*style_)));
+const char *parse_style(struct arena *arena, const char *pos, const char *end, struct style **style) {
+  struct style *style_ = arena_alloc(arena, sizeof(*style_));
   pos = parse_style_inner(pos, end, style_);
   if (!pos) {
     parse_error("Expected style");
-    free(style_);
     return NULL;
   }
   pos = skip_whitespace(pos, end);
   if (!at_end(pos, end)) {
     parse_error("Expected end of style");
-    free(style_);
     return NULL;
   }
   *style = style_;
   return pos;
 }
 
-const char *parse_style_cstr(const char *str, struct style **style) {
-  return parse_style(str, str + strlen(str), style);
+const char *parse_style_cstr(struct arena *arena, const char *str, struct style **style) {
+  return parse_style(arena, str, str + strlen(str), style);
 }
 
-const char *parse_palette(const char *pos, const char *end, struct palette **palette) {
-  struct palette *palette_ = palette_create();
+const char *parse_palette(struct arena *arena, const char *pos, const char *end, struct palette **palette) {
+  struct palette *palette_ = palette_create(arena);
   struct style *style = palette_add(palette_);
   pos = parse_style_inner(pos, end, style);
   if (!pos) {
     parse_error("Expected style");
-    palette_free(palette_);
     return NULL;
   }
   while (true) {
@@ -194,20 +176,18 @@ const char *parse_palette(const char *pos, const char *end, struct palette **pal
     pos = parse_style_inner(pos_, end, style);
     if (!pos) {
       parse_error("Expected style");
-      palette_free(palette_);
       return NULL;
     }
   }
   pos = skip_whitespace(pos, end);
   if (!at_end(pos, end)) {
     parse_error("Expected end of palette");
-    palette_free(palette_);
     return NULL;
   }
   *palette = palette_;
   return pos;
 }
 
-const char *parse_palette_cstr(const char *str, struct palette **palette) {
-  return parse_palette(str, str + strlen(str), palette);
+const char *parse_palette_cstr(struct arena *arena, const char *str, struct palette **palette) {
+  return parse_palette(arena, str, str + strlen(str), palette);
 }
@@ -4,54 +4,36 @@
 
 #include "styles.h"
 #include "utils.h"
-
-enum {
-  INITIAL_PALETTE_SIZE = 32
-};
+#include "vector.h"
 
 bool bool_attr_enabled(const struct bool_attr *attr) {
   return attr->state == ATTR_STATE_SET && attr->value;
 }
 
+// Palettes are either allocated from an arena or static tables that are
+// never modified
+
 struct palette {
-  struct style *styles;
-  size_t size;
-  size_t cap;
+  struct vector styles; // Of struct style
 };
 
-struct palette *palette_create(void) {
-  struct palette *palette = check(malloc(sizeof(*palette)));
-  struct style *styles = check(calloc(INITIAL_PALETTE_SIZE, sizeof(*styles)));
-  palette->size = 0;
-  palette->cap = INITIAL_PALETTE_SIZE;
-  palette->styles = styles;
+struct palette *palette_create(struct arena *arena) {
+  struct palette *palette = arena_alloc(arena, sizeof(*palette));
+  vector_init(&palette->styles, arena, sizeof(struct style));
   return palette;
 }
 
 struct style *palette_get(const struct palette *palette, size_t index) {
-  assert(index < palette->size);
-  return palette->styles + index;
+  assert(index < vector_size(&palette->styles));
+  return vector_get(&palette->styles, index);
 }
 
 struct style *palette_add(struct palette *palette) {
-  if (palette->size >= palette->cap) {
-    size_t new_cap = palette->cap * 2;
-    palette->styles = check(realloc(palette->styles, new_cap));
-    palette->cap = new_cap;
-  }
-  struct style *style = palette->styles + palette->size;
-  memset(style, 0, sizeof(*style));
-  palette->size++;
-  return style;
+  return vector_push(&palette->styles);
 }
 
 size_t palette_size(const struct palette *palette) {
-  return palette->size;
-}
-
-void palette_free(struct palette *palette) {
-  free(palette->styles);
-  free(palette);
+  return vector_size(&palette->styles);
 }
 
 // Default styles
@@ -64,9 +46,7 @@ static struct style SEPARATOR_STYLES_8[] = {
 };
 
 static struct palette SEPARATOR_PALETTE_8_ = {
-  .styles = SEPARATOR_STYLES_8,
-  .size = ARRAY_SIZE(SEPARATOR_STYLES_8),
-  .cap  = ARRAY_SIZE(SEPARATOR_STYLES_8),
+  .styles = STATIC_VECTOR(SEPARATOR_STYLES_8),
 };
 
 
@@ -82,9 +62,7 @@ static struct style PATH_STYLES_8[] = {
 };
 
 static struct palette PATH_PALETTE_8_ = {
-  .styles = PATH_STYLES_8,
-  .size = ARRAY_SIZE(PATH_STYLES_8),
-  .cap = ARRAY_SIZE(PATH_STYLES_8),
+  .styles = STATIC_VECTOR(PATH_STYLES_8),
 };
 
 const struct palette *PATH_PALETTE_8 = &PATH_PALETTE_8_;
@@ -97,9 +75,7 @@ static struct style SEPARATOR_STYLES_256[] = {
 };
 
 static struct palette SEPARATOR_PALETTE_256_ = {
-  .styles = SEPARATOR_STYLES_256,
-  .size = ARRAY_SIZE(SEPARATOR_STYLES_256),
-  .cap = ARRAY_SIZE(SEPARATOR_STYLES_256),
+  .styles = STATIC_VECTOR(SEPARATOR_STYLES_256),
 };
 
 const struct palette *SEPARATOR_PALETTE_256 = &SEPARATOR_PALETTE_256_;
@@ -114,9 +90,136 @@ static struct style PATH_STYLES_256[] = {
 };
 
 static struct palette PATH_PALETTE_256_ = {
-  .styles = PATH_STYLES_256,
-  .size = ARRAY_SIZE(PATH_STYLES_256),
-  .cap = ARRAY_SIZE(PATH_STYLES_256),
+  .styles = STATIC_VECTOR(PATH_STYLES_256),
 };
 
 const struct palette *PATH_PALETTE_256 = &PATH_PALETTE_256_;
+
+// Themes
+
+#define FG(color) .fg = { .state = ATTR_STATE_SET, .value = (color) }
+#define BOLD .bold = { .state = ATTR_STATE_SET, .value = true }
+#define DIM .dim = { .state = ATTR_STATE_SET, .value = true }
+
+#define STATIC_PALETTE(styles_) { .styles = STATIC_VECTOR(styles_) }
+
+struct theme {
+  const char *name;
+  const struct palette *path_palette_8;
+  const struct palette *path_palette_256;
+  const struct palette *separator_palette_8;
+  const struct palette *separator_palette_256;
+};
+
+static struct style SOLARIZED_PATH_STYLES_8[] = {
+  { FG(3) }, { FG(1) }, { FG(5) }, { FG(4) }, { FG(6) }, { FG(2) },
+};
+static struct style SOLARIZED_PATH_STYLES_256[] = {
+  { FG(136) }, { FG(166) }, { FG(160) }, { FG(125) },
+  { FG(61) }, { FG(33) }, { FG(37) }, { FG(64) },
+};
+static struct style SOLARIZED_SEPARATOR_STYLES_8[] = { { FG(7), DIM } };
+static struct style SOLARIZED_SEPARATOR_STYLES_256[] = { { FG(240) } };
+
+static struct palette SOLARIZED_PALETTES[] = {
+  STATIC_PALETTE(SOLARIZED_PATH_STYLES_8),
+  STATIC_PALETTE(SOLARIZED_PATH_STYLES_256),
+  STATIC_PALETTE(SOLARIZED_SEPARATOR_STYLES_8),
+  STATIC_PALETTE(SOLARIZED_SEPARATOR_STYLES_256),
+};
+
+static struct style NORD_PATH_STYLES_8[] = {
+  { FG(6) }, { FG(4) }, { FG(2) }, { FG(3) }, { FG(5) },
+};
+static struct style NORD_PATH_STYLES_256[] = {
+  { FG(110) }, { FG(109) }, { FG(67) }, { FG(150) }, { FG(179) }, { FG(139) },
+};
+static struct style NORD_SEPARATOR_STYLES_8[] = { { FG(4), DIM } };
+static struct style NORD_SEPARATOR_STYLES_256[] = { { FG(60), BOLD } };
+
+static struct palette NORD_PALETTES[] = {
+  STATIC_PALETTE(NORD_PATH_STYLES_8),
+  STATIC_PALETTE(NORD_PATH_STYLES_256),
+  STATIC_PALETTE(NORD_SEPARATOR_STYLES_8),
+  STATIC_PALETTE(NORD_SEPARATOR_STYLES_256),
+};
+
+static struct style GRUVBOX_PATH_STYLES_8[] = {
+  { FG(1) }, { FG(3) }, { FG(2) }, { FG(6) }, { FG(4) }, { FG(5) },
+};
+static struct style GRUVBOX_PATH_STYLES_256[] = {
+  { FG(167) }, { FG(208) }, { FG(214) }, { FG(142) },
+  { FG(108) }, { FG(109) }, { FG(175) },
+};
+static struct style GRUVBOX_SEPARATOR_STYLES_8[] = { { FG(7), DIM } };
+static struct style GRUVBOX_SEPARATOR_STYLES_256[] = { { FG(243), BOLD } };
+
+static struct palette GRUVBOX_PALETTES[] = {
+  STATIC_PALETTE(GRUVBOX_PATH_STYLES_8),
+  STATIC_PALETTE(GRUVBOX_PATH_STYLES_256),
+  STATIC_PALETTE(GRUVBOX_SEPARATOR_STYLES_8),
+  STATIC_PALETTE(GRUVBOX_SEPARATOR_STYLES_256),
+};
+
+static struct style MONO_PATH_STYLES_8[] = {
+  { FG(7), BOLD }, { FG(7) },
+};
+static struct style MONO_PATH_STYLES_256[] = {
+  { FG(255), BOLD }, { FG(250) }, { FG(245) },
+};
+static struct style MONO_SEPARATOR_STYLES_8[] = { { FG(7), DIM } };
+static struct style MONO_SEPARATOR_STYLES_256[] = { { FG(240) } };
+
+static struct palette MONO_PALETTES[] = {
+  STATIC_PALETTE(MONO_PATH_STYLES_8),
+  STATIC_PALETTE(MONO_PATH_STYLES_256),
+  STATIC_PALETTE(MONO_SEPARATOR_STYLES_8),
+  STATIC_PALETTE(MONO_SEPARATOR_STYLES_256),
+};
+
+#define THEME(name_, palettes) {                \
+    .name = name_,                              \
+    .path_palette_8 = &palettes[0],             \
+    .path_palette_256 = &palettes[1],           \
+    .separator_palette_8 = &palettes[2],        \
+    .separator_palette_256 = &palettes[3],      \
+  }
+
+static const struct theme THEMES[] = {
+  {
+    .name = "default",
+    .path_palette_8 = &PATH_PALETTE_8_,
+    .path_palette_256 = &PATH_PALETTE_256_,
+    .separator_palette_8 = &SEPARATOR_PALETTE_8_,
+    .separator_palette_256 = &SEPARATOR_PALETTE_256_,
+  },
+  THEME("solarized", SOLARIZED_PALETTES),
+  THEME("nord", NORD_PALETTES),
+  THEME("gruvbox", GRUVBOX_PALETTES),
+  THEME("mono", MONO_PALETTES),
+};
+
+const struct theme *get_theme(const char *name) {
+  for (size_t i = 0; i < ARRAY_SIZE(THEMES); i++) {
+    if (!strcmp(THEMES[i].name, name)) {
+      return &THEMES[i];
+    }
+  }
+  return NULL;
+}
+
+const char *theme_name(const struct theme *theme) {
+  return theme->name;
+}
+
+const struct palette *theme_path_palette(const struct theme *theme,
+                                         int color_count) {
+  return color_count >= 256 ? theme->path_palette_256 : theme->path_palette_8;
+}
+
+const struct palette *theme_separator_palette(const struct theme *theme,
+                                              int color_count) {
+  return color_count >= 256
+    ? theme->separator_palette_256
+    : theme->separator_palette_8;
+}
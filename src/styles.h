@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "arena.h"
+
 enum attr_state {
   ATTR_STATE_UNSET,
   ATTR_STATE_SET,
@@ -34,15 +36,23 @@ struct style {
 
 struct palette;
 
-struct palette *palette_create(void);
+struct palette *palette_create(struct arena *arena);
 struct style *palette_get(const struct palette *palette, size_t index);
 struct style *palette_add(struct palette *palette);
 size_t palette_size(const struct palette *palette);
-void palette_free(struct palette *palette);
 
 extern const struct palette *SEPARATOR_PALETTE_8;
 extern const struct palette *SEPARATOR_PALETTE_256;
 extern const struct palette *PATH_PALETTE_8;
 extern const struct palette *PATH_PALETTE_256;
 
+// Built-in themes with palettes for 8 and 256 color terminals
+
+struct theme;
+
+const struct theme *get_theme(const char *name);
+const char *theme_name(const struct theme *theme);
+const struct palette *theme_path_palette(const struct theme *theme, int color_count);
+const struct palette *theme_separator_palette(const struct theme *theme, int color_count);
+
 #endif
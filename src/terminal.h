@@ -4,17 +4,23 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "bytes.h"
+
 struct terminal;
 
 struct terminal *terminal_create(void);
+struct terminal *terminal_create_fallback(void);
 int terminal_color_count(struct terminal *terminal);
-void terminal_fg(struct terminal *terminal, uint8_t color);
-void terminal_bg(struct terminal *terminal, uint8_t color);
-void terminal_bold(struct terminal *terminal);
-void terminal_dim(struct terminal *terminal);
-void terminal_underlined(struct terminal *terminal);
-void terminal_blink(struct terminal *terminal);
-void terminal_reset_style(struct terminal *terminal);
+
+// Control sequences are appended to out
+void terminal_fg(struct terminal *terminal, struct bytes *out, uint8_t color);
+void terminal_bg(struct terminal *terminal, struct bytes *out, uint8_t color);
+void terminal_bold(struct terminal *terminal, struct bytes *out);
+void terminal_dim(struct terminal *terminal, struct bytes *out);
+void terminal_underlined(struct terminal *terminal, struct bytes *out);
+void terminal_blink(struct terminal *terminal, struct bytes *out);
+void terminal_reset_style(struct terminal *terminal, struct bytes *out);
+
 void terminal_free(struct terminal *terminal);
 
 #endif
@@ -0,0 +1,411 @@
+#include "build.h"
+
+#include "terminfo.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "bytes.h"
+#include "utils.h"
+
+// Minimal reader for compiled terminfo entries (see term(5)). Only the
+// handful of capabilities needed for styling text are extracted.
+
+enum {
+  TERMINFO_MAGIC_LEGACY = 0432,
+  TERMINFO_MAGIC_EXTENDED = 01036,
+  TERMINFO_HEADER_SIZE = 12,
+  TERMINFO_COLORS = 13,
+};
+
+static const int STRING_INDICES[TERMINFO_STRING_COUNT] = {
+  [TERMINFO_SETAF] = 359,
+  [TERMINFO_SETAB] = 360,
+  [TERMINFO_BOLD] = 27,
+  [TERMINFO_DIM] = 30,
+  [TERMINFO_SMUL] = 36,
+  [TERMINFO_BLINK] = 26,
+  [TERMINFO_SGR0] = 39,
+};
+
+static const char *SYSTEM_DIRECTORIES[] = {
+  "/etc/terminfo",
+  "/lib/terminfo",
+  "/usr/share/terminfo",
+};
+
+static uint16_t read_u16(const uint8_t *data) {
+  return data[0] | data[1] << 8;
+}
+
+static int32_t read_i32(const uint8_t *data) {
+  return (int32_t)((uint32_t)data[0]
+                   | (uint32_t)data[1] << 8
+                   | (uint32_t)data[2] << 16
+                   | (uint32_t)data[3] << 24);
+}
+
+// Capabilities are collected into a single allocation owned by the terminfo
+static void set_strings(struct terminfo *terminfo,
+                        const char *strings[TERMINFO_STRING_COUNT]) {
+  struct bytes *data = bytes_create(NULL);
+  size_t offsets[TERMINFO_STRING_COUNT];
+  for (size_t i = 0; i < TERMINFO_STRING_COUNT; i++) {
+    offsets[i] = bytes_size(data);
+    if (strings[i]) {
+      bytes_append(data, strings[i], strlen(strings[i]) + 1);
+    }
+  }
+  bytes_append_char(data, '\0');
+  terminfo->data = bytes_take(data);
+  for (size_t i = 0; i < TERMINFO_STRING_COUNT; i++) {
+    terminfo->strings[i] = strings[i] ? terminfo->data + offsets[i] : NULL;
+  }
+}
+
+static bool parse_entry(const uint8_t *data, size_t length, struct terminfo *terminfo) {
+  if (length < TERMINFO_HEADER_SIZE) {
+    return false;
+  }
+  size_t number_size;
+  switch (read_u16(data)) {
+  case TERMINFO_MAGIC_LEGACY:
+    number_size = 2;
+    break;
+  case TERMINFO_MAGIC_EXTENDED:
+    number_size = 4;
+    break;
+  default:
+    return false;
+  }
+  size_t names_size = read_u16(data + 2);
+  size_t bool_count = read_u16(data + 4);
+  size_t number_count = read_u16(data + 6);
+  size_t string_count = read_u16(data + 8);
+  size_t table_size = read_u16(data + 10);
+  size_t numbers = TERMINFO_HEADER_SIZE + names_size + bool_count;
+  numbers += numbers % 2;
+  size_t offsets = numbers + number_count * number_size;
+  size_t table = offsets + string_count * 2;
+  if (table + table_size > length) {
+    return false;
+  }
+
+  terminfo->colors = -1;
+  if (TERMINFO_COLORS < number_count) {
+    const uint8_t *number = data + numbers + TERMINFO_COLORS * number_size;
+    terminfo->colors = number_size == 2
+      ? (int16_t)read_u16(number)
+      : read_i32(number);
+  }
+
+  const char *strings[TERMINFO_STRING_COUNT] = { 0 };
+  for (size_t i = 0; i < TERMINFO_STRING_COUNT; i++) {
+    size_t index = STRING_INDICES[i];
+    if (index >= string_count) {
+      continue;
+    }
+    int16_t offset = read_u16(data + offsets + index * 2);
+    if (offset < 0) {
+      continue;
+    }
+    const char *str = (const char *)data + table + offset;
+    if ((size_t)offset >= table_size
+        || !memchr(str, '\0', table_size - offset)) {
+      return false;
+    }
+    strings[i] = str;
+  }
+  set_strings(terminfo, strings);
+  return true;
+}
+
+static int open_in_directory(const char *directory, const char *term) {
+  char *path = check_asprintf("%s/%c/%s", directory, term[0], term);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  free(path);
+  if (fd < 0) {
+    // Some systems use the hexadecimal value of the first character
+    path = check_asprintf("%s/%02x/%s", directory, (unsigned char)term[0], term);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+  }
+  return fd;
+}
+
+// Search the directories consulted by ncurses in the same order
+static int open_entry(const char *term) {
+  int fd;
+  const char *terminfo = get_env("TERMINFO");
+  if (terminfo && (fd = open_in_directory(terminfo, term)) >= 0) {
+    return fd;
+  }
+  const char *home = get_env("HOME");
+  if (home) {
+    char *directory = check_asprintf("%s/.terminfo", home);
+    fd = open_in_directory(directory, term);
+    free(directory);
+    if (fd >= 0) {
+      return fd;
+    }
+  }
+  const char *terminfo_dirs = get_env("TERMINFO_DIRS");
+  if (terminfo_dirs) {
+    char *component;
+    char *state;
+    char *dirs = check(strdup(terminfo_dirs));
+    for (component = strtok_r(dirs, ":", &state);
+         component;
+         component = strtok_r(NULL, ":", &state)) {
+      if ((fd = open_in_directory(component, term)) >= 0) {
+        free(dirs);
+        return fd;
+      }
+    }
+    free(dirs);
+  }
+  for (size_t i = 0; i < ARRAY_SIZE(SYSTEM_DIRECTORIES); i++) {
+    if ((fd = open_in_directory(SYSTEM_DIRECTORIES[i], term)) >= 0) {
+      return fd;
+    }
+  }
+  return -1;
+}
+
+bool terminfo_load(const char *term, struct terminfo *terminfo) {
+  if (!*term || strchr(term, '/') || !strcmp(term, ".") || !strcmp(term, "..")) {
+    return false;
+  }
+  int fd = open_entry(term);
+  if (fd < 0) {
+    return false;
+  }
+  bool ret = false;
+  struct stat buf;
+  if (fstat(fd, &buf) != 0 || buf.st_size == 0) {
+    goto out;
+  }
+  void *data = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    goto out;
+  }
+  ret = parse_entry(data, buf.st_size, terminfo);
+  munmap(data, buf.st_size);
+ out:
+  close(fd);
+  return ret;
+}
+
+void terminfo_free(struct terminfo *terminfo) {
+  free(terminfo->data);
+}
+
+// Parameterized string expansion (see terminfo(5)). Supports the full
+// language apart from string parameters, which are not needed for colors.
+
+enum {
+  STACK_SIZE = 16
+};
+
+struct expansion {
+  char *out;
+  size_t size;
+  size_t length;
+  int stack[STACK_SIZE];
+  size_t depth;
+};
+
+static void emit(struct expansion *expansion, const char *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (expansion->length + 1 < expansion->size) {
+      expansion->out[expansion->length++] = data[i];
+    }
+  }
+}
+
+static void push(struct expansion *expansion, int value) {
+  if (expansion->depth < STACK_SIZE) {
+    expansion->stack[expansion->depth++] = value;
+  }
+}
+
+static int pop(struct expansion *expansion) {
+  return expansion->depth ? expansion->stack[--expansion->depth] : 0;
+}
+
+// Skip over a conditional branch. Returns position after the matching %e
+// (if else_part is set) or %;.
+static const char *skip_branch(const char *pos, bool else_part) {
+  int nesting = 0;
+  while (*pos) {
+    if (*pos++ != '%' || !*pos) {
+      continue;
+    }
+    char c = *pos++;
+    if (c == '?') {
+      nesting++;
+    } else if (c == ';') {
+      if (nesting == 0) {
+        return pos;
+      }
+      nesting--;
+    } else if (c == 'e' && else_part && nesting == 0) {
+      return pos;
+    }
+  }
+  return pos;
+}
+
+static const char *skip_padding(const char *pos) {
+  const char *end = strchr(pos + 2, '>');
+  return end ? end + 1 : pos + strlen(pos);
+}
+
+size_t terminfo_expand(const char *cap, int param, char *out, size_t size) {
+  struct expansion expansion = { .out = out, .size = size };
+  int params[9] = { param };
+  int variables[52] = { 0 };
+  const char *pos = cap;
+  while (*pos) {
+    if (*pos == '$' && pos[1] == '<') {
+      pos = skip_padding(pos);
+      continue;
+    }
+    if (*pos != '%') {
+      emit(&expansion, pos++, 1);
+      continue;
+    }
+    pos++;
+    char format[16] = "%";
+    size_t format_length = 1;
+    // '-' and '+' are only flags when preceded by ':'
+    const char *flags = "# 0123456789.";
+    if (*pos == ':') {
+      flags = "-+# 0123456789.";
+      pos++;
+    }
+    while (*pos && strchr(flags, *pos) && format_length < sizeof(format) - 2) {
+      format[format_length++] = *pos++;
+    }
+    int a;
+    int b;
+    switch (*pos) {
+    case 'd':
+    case 'o':
+    case 'x':
+    case 'X': {
+      char buffer[32];
+      format[format_length++] = *pos;
+      format[format_length] = '\0';
+      int length = snprintf(buffer, sizeof(buffer), format, pop(&expansion));
+      if (length > 0) {
+        emit(&expansion, buffer, (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1);
+      }
+      break;
+    }
+    case 'c': {
+      char c = pop(&expansion);
+      emit(&expansion, &c, 1);
+      break;
+    }
+    case '%':
+      emit(&expansion, "%", 1);
+      break;
+    case 'p':
+      pos++;
+      if ('1' <= *pos && *pos <= '9') {
+        push(&expansion, params[*pos - '1']);
+      } else if (!*pos) {
+        pos--;
+      }
+      break;
+    case 'P':
+    case 'g': {
+      char op = *pos++;
+      int index = -1;
+      if ('a' <= *pos && *pos <= 'z') {
+        index = *pos - 'a';
+      } else if ('A' <= *pos && *pos <= 'Z') {
+        index = 26 + *pos - 'A';
+      } else if (!*pos) {
+        pos--;
+      }
+      if (index >= 0) {
+        if (op == 'P') {
+          variables[index] = pop(&expansion);
+        } else {
+          push(&expansion, variables[index]);
+        }
+      }
+      break;
+    }
+    case '\'':
+      if (pos[1]) {
+        push(&expansion, (unsigned char)pos[1]);
+        pos += pos[2] == '\'' ? 2 : 1;
+      }
+      break;
+    case '{': {
+      int value = 0;
+      for (pos++; '0' <= *pos && *pos <= '9'; pos++) {
+        value = value * 10 + (*pos - '0');
+      }
+      push(&expansion, value);
+      if (*pos != '}') {
+        pos--;
+      }
+      break;
+    }
+    case 'l':
+      pop(&expansion);
+      push(&expansion, 0);
+      break;
+    case '+': b = pop(&expansion); a = pop(&expansion); push(&expansion, a + b); break;
+    case '-': b = pop(&expansion); a = pop(&expansion); push(&expansion, a - b); break;
+    case '*': b = pop(&expansion); a = pop(&expansion); push(&expansion, a * b); break;
+    case '/': b = pop(&expansion); a = pop(&expansion); push(&expansion, b ? a / b : 0); break;
+    case 'm': b = pop(&expansion); a = pop(&expansion); push(&expansion, b ? a % b : 0); break;
+    case '&': b = pop(&expansion); a = pop(&expansion); push(&expansion, a & b); break;
+    case '|': b = pop(&expansion); a = pop(&expansion); push(&expansion, a | b); break;
+    case '^': b = pop(&expansion); a = pop(&expansion); push(&expansion, a ^ b); break;
+    case '=': b = pop(&expansion); a = pop(&expansion); push(&expansion, a == b); break;
+    case '<': b = pop(&expansion); a = pop(&expansion); push(&expansion, a < b); break;
+    case '>': b = pop(&expansion); a = pop(&expansion); push(&expansion, a > b); break;
+    case 'A': b = pop(&expansion); a = pop(&expansion); push(&expansion, a && b); break;
+    case 'O': b = pop(&expansion); a = pop(&expansion); push(&expansion, a || b); break;
+    case '!': push(&expansion, !pop(&expansion)); break;
+    case '~': push(&expansion, ~pop(&expansion)); break;
+    case 'i':
+      params[0]++;
+      params[1]++;
+      break;
+    case '?':
+    case ';':
+      break;
+    case 't':
+      if (!pop(&expansion)) {
+        pos = skip_branch(pos + 1, true);
+        continue;
+      }
+      break;
+    case 'e':
+      pos = skip_branch(pos + 1, false);
+      continue;
+    case '\0':
+      continue;
+    default:
+      break;
+    }
+    pos++;
+  }
+  if (size) {
+    out[expansion.length] = '\0';
+  }
+  return expansion.length;
+}
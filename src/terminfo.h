@@ -0,0 +1,29 @@
+#ifndef TERMINFO_H
+#define TERMINFO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum terminfo_string {
+  TERMINFO_SETAF,
+  TERMINFO_SETAB,
+  TERMINFO_BOLD,
+  TERMINFO_DIM,
+  TERMINFO_SMUL,
+  TERMINFO_BLINK,
+  TERMINFO_SGR0,
+  TERMINFO_STRING_COUNT
+};
+
+struct terminfo {
+  int colors; // Negative if absent
+  const char *strings[TERMINFO_STRING_COUNT]; // NULL if absent
+  char *data;
+};
+
+bool terminfo_load(const char *term, struct terminfo *terminfo);
+void terminfo_free(struct terminfo *terminfo);
+
+size_t terminfo_expand(const char *cap, int param, char *out, size_t size);
+
+#endif
@@ -0,0 +1,536 @@
+#include "tree.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "bytes.h"
+#include "vector.h"
+#include "utils.h"
+
+// Paths are shown as a tree with a line for each directory and file, indented
+// by depth. Every name is shown once below its parent, in the order in which
+// it first appears in the input.
+//
+// Paths are gathered into a prefix trie. Names are interned, nodes and their
+// lists of children live in an arena, and children are found through a table
+// keyed by parent and name that only holds node numbers, so a node takes the
+// same few dozen bytes whatever its name. As a directory may get more children
+// until the input ends, nothing is printed before that.
+//
+// Input in which paths sharing a directory follow each other, such as the
+// output of find or a sorted list, does not need the trie. If the paths of a
+// first window are grouped that way, the trie is printed and the rest of the
+// paths are printed as they are read, keeping only the directories of the
+// previous path. A directory that is entered again after that is shown
+// again.
+
+enum {
+  TREE_BUFFER_SIZE = 256 * 1024,
+  TREE_OUTPUT_SIZE = 256 * 1024,
+  TREE_WINDOW = 64 * 1024, // Paths gathered before deciding to stream
+  TREE_INDENT = 2,
+  INITIAL_TABLE_SIZE = 1024, // Power of two
+  POOL_BLOCK_SHIFT = 12,
+  POOL_BLOCK_SIZE = 1 << POOL_BLOCK_SHIFT, // Elements in each block of a pool
+  NAME_BLOCK_SIZE = 64 * 1024 // Bytes of names packed into each block
+};
+
+// Array of elements allocated in blocks that never move, so that a growing
+// array does not leave copies of itself behind in the arena
+struct pool {
+  struct vector *blocks; // Of pointers to blocks of POOL_BLOCK_SIZE elements
+  size_t elem_size;
+  size_t size;
+};
+
+struct node {
+  uint32_t parent;
+  uint32_t name;
+  uint32_t child_count;
+  uint32_t child_capacity;
+  uint32_t *children;
+};
+
+// Directory of the previous path while streaming
+struct level {
+  size_t offset; // Of the name in level_names
+  size_t length;
+};
+
+struct frame {
+  uint32_t node;
+  uint32_t next; // Child to print next
+};
+
+struct tree {
+  const struct renderer *renderer;
+  const struct config *config;
+  int out;
+  const struct string_view *terminator;
+  struct arena *arena;
+  struct bytes *output;
+  struct vector *components; // Of struct string_view, of the current path
+  size_t path_count;
+  bool streaming;
+  bool grouped; // Whether paths sharing a directory have followed each other
+  // Trie of the paths, freed when streaming starts
+  struct arena *trie_arena;
+  struct pool nodes; // Of struct node, starting with the root
+  struct pool names; // Of struct string_view
+  char *name_block; // Unused bytes for packing names
+  size_t name_block_left;
+  uint32_t *name_slots; // Name numbers plus one, zero for empty slots
+  size_t name_capacity;
+  uint32_t *edges; // Nodes by parent and name, zero for empty slots
+  size_t edge_count;
+  size_t edge_capacity;
+  struct vector *branch; // Of uint32_t, nodes of the previous path
+  // Directories of the previous path while streaming
+  struct vector *levels; // Of struct level
+  struct bytes *level_names;
+};
+
+static void pool_init(struct pool *pool, struct arena *arena, size_t elem_size) {
+  pool->blocks = vector_create(arena, sizeof(void *));
+  pool->elem_size = elem_size;
+  pool->size = 0;
+}
+
+static inline void *pool_get(const struct pool *pool, size_t index) {
+  char *block = *(char **)vector_get(pool->blocks, index >> POOL_BLOCK_SHIFT);
+  return block + (index & (POOL_BLOCK_SIZE - 1)) * pool->elem_size;
+}
+
+// Append a zeroed element and return it
+static void *pool_push(struct pool *pool) {
+  if (pool->size == vector_size(pool->blocks) * POOL_BLOCK_SIZE) {
+    *(void **)vector_push(pool->blocks) = arena_alloc(pool->blocks->arena,
+                                                      POOL_BLOCK_SIZE * pool->elem_size);
+  }
+  void *elem = pool_get(pool, pool->size++);
+  memset(elem, 0, pool->elem_size);
+  return elem;
+}
+
+static const struct string_view ROOT = { "/", 1 };
+static const struct string_view HOME = { "~", 1 };
+
+struct tree *tree_create(const struct renderer *renderer,
+                         const struct config *config,
+                         int out,
+                         const struct string_view *terminator) {
+  struct tree *tree = check(malloc(sizeof(*tree)));
+  tree->renderer = renderer;
+  tree->config = config;
+  tree->out = out;
+  tree->terminator = terminator;
+  tree->arena = arena_create();
+  tree->output = bytes_create(NULL);
+  tree->components = vector_create(tree->arena, sizeof(struct string_view));
+  tree->path_count = 0;
+  tree->streaming = false;
+  tree->grouped = true;
+  tree->trie_arena = arena_create();
+  pool_init(&tree->nodes, tree->trie_arena, sizeof(struct node));
+  pool_push(&tree->nodes);
+  pool_init(&tree->names, tree->trie_arena, sizeof(struct string_view));
+  tree->name_block = NULL;
+  tree->name_block_left = 0;
+  tree->name_capacity = INITIAL_TABLE_SIZE;
+  tree->name_slots = check(calloc(tree->name_capacity, sizeof(*tree->name_slots)));
+  tree->edge_count = 0;
+  tree->edge_capacity = INITIAL_TABLE_SIZE;
+  tree->edges = check(calloc(tree->edge_capacity, sizeof(*tree->edges)));
+  tree->branch = vector_create(tree->trie_arena, sizeof(uint32_t));
+  tree->levels = vector_create(tree->arena, sizeof(struct level));
+  tree->level_names = bytes_create(NULL);
+  return tree;
+}
+
+static void free_trie(struct tree *tree) {
+  if (tree->trie_arena) {
+    free(tree->name_slots);
+    free(tree->edges);
+    arena_free(tree->trie_arena);
+    tree->trie_arena = NULL;
+  }
+}
+
+void tree_free(struct tree *tree) {
+  free_trie(tree);
+  bytes_free(tree->level_names);
+  bytes_free(tree->output);
+  arena_free(tree->arena);
+  free(tree);
+}
+
+static size_t hash_name(const struct string_view *name) {
+  uint64_t hash = UINT64_C(0xcbf29ce484222325);
+  for (size_t i = 0; i < name->length; i++) {
+    hash = (hash ^ (unsigned char)name->data[i]) * UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+static size_t hash_edge(uint32_t parent, uint32_t name) {
+  uint64_t key = (uint64_t)parent << 32 | name;
+  return (key * UINT64_C(0x9e3779b97f4a7c15)) >> 32;
+}
+
+static bool is_root(const struct string_view *name) {
+  // Names of components never contain separators
+  return name->length == 1 && name->data[0] == '/';
+}
+
+static void grow_names(struct tree *tree) {
+  size_t capacity = tree->name_capacity * 2;
+  uint32_t *slots = check(calloc(capacity, sizeof(*slots)));
+  for (size_t i = 0; i < tree->names.size; i++) {
+    size_t slot = hash_name(pool_get(&tree->names, i)) & (capacity - 1);
+    while (slots[slot]) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    slots[slot] = i + 1;
+  }
+  free(tree->name_slots);
+  tree->name_slots = slots;
+  tree->name_capacity = capacity;
+}
+
+// Copy a name next to the names before it, without terminating or aligning it
+static const char *pack_name(struct tree *tree, const struct string_view *name) {
+  if (name->length > NAME_BLOCK_SIZE / 4) {
+    return arena_strndup(tree->trie_arena, name->data, name->length);
+  }
+  if (name->length > tree->name_block_left) {
+    tree->name_block = arena_alloc(tree->trie_arena, NAME_BLOCK_SIZE);
+    tree->name_block_left = NAME_BLOCK_SIZE;
+  }
+  char *packed = tree->name_block;
+  memcpy(packed, name->data, name->length);
+  tree->name_block += name->length;
+  tree->name_block_left -= name->length;
+  return packed;
+}
+
+static uint32_t intern_name(struct tree *tree, const struct string_view *name) {
+  size_t mask = tree->name_capacity - 1;
+  size_t slot = hash_name(name) & mask;
+  for (; tree->name_slots[slot]; slot = (slot + 1) & mask) {
+    const struct string_view *interned = pool_get(&tree->names, tree->name_slots[slot] - 1);
+    if (interned->length == name->length
+        && !memcmp(interned->data, name->data, name->length)) {
+      return tree->name_slots[slot] - 1;
+    }
+  }
+  if (tree->names.size >= UINT32_MAX - 1) {
+    fatal("Too many paths for a tree");
+  }
+  uint32_t number = tree->names.size;
+  struct string_view *interned = pool_push(&tree->names);
+  interned->data = pack_name(tree, name);
+  interned->length = name->length;
+  tree->name_slots[slot] = number + 1;
+  if (2 * tree->names.size > tree->name_capacity) {
+    grow_names(tree);
+  }
+  return number;
+}
+
+static void put_edge(const struct tree *tree, uint32_t *edges, size_t capacity, uint32_t child) {
+  const struct node *node = pool_get(&tree->nodes, child);
+  size_t slot = hash_edge(node->parent, node->name) & (capacity - 1);
+  while (edges[slot]) {
+    slot = (slot + 1) & (capacity - 1);
+  }
+  edges[slot] = child;
+}
+
+static void grow_edges(struct tree *tree) {
+  size_t capacity = tree->edge_capacity * 2;
+  uint32_t *edges = check(calloc(capacity, sizeof(*edges)));
+  for (size_t i = 0; i < tree->edge_capacity; i++) {
+    if (tree->edges[i]) {
+      put_edge(tree, edges, capacity, tree->edges[i]);
+    }
+  }
+  free(tree->edges);
+  tree->edges = edges;
+  tree->edge_capacity = capacity;
+}
+
+// Returns zero if parent has no child with the name, as the root is no one's
+// child
+static uint32_t find_child(const struct tree *tree, uint32_t parent, uint32_t name) {
+  size_t mask = tree->edge_capacity - 1;
+  size_t slot = hash_edge(parent, name) & mask;
+  for (; tree->edges[slot]; slot = (slot + 1) & mask) {
+    const struct node *node = pool_get(&tree->nodes, tree->edges[slot]);
+    if (node->parent == parent && node->name == name) {
+      return tree->edges[slot];
+    }
+  }
+  return 0;
+}
+
+static uint32_t add_child(struct tree *tree, uint32_t parent, uint32_t name) {
+  if (tree->nodes.size >= UINT32_MAX - 1) {
+    fatal("Too many paths for a tree");
+  }
+  uint32_t child = tree->nodes.size;
+  struct node *node = pool_push(&tree->nodes);
+  node->parent = parent;
+  node->name = name;
+  node = pool_get(&tree->nodes, parent);
+  if (node->child_count == node->child_capacity) {
+    uint32_t capacity = node->child_capacity ? node->child_capacity * 2 : 2;
+    node->children = arena_grow(tree->trie_arena,
+                                node->children,
+                                node->child_count * sizeof(*node->children),
+                                capacity * sizeof(*node->children));
+    node->child_capacity = capacity;
+  }
+  node->children[node->child_count++] = child;
+  put_edge(tree, tree->edges, tree->edge_capacity, child);
+  if (2 * ++tree->edge_count > tree->edge_capacity) {
+    grow_edges(tree);
+  }
+  return child;
+}
+
+static bool flush_output(int fd, struct bytes *output) {
+  bool written = write_all(fd, bytes_data(output), bytes_size(output));
+  bytes_clear(output);
+  return written;
+}
+
+// Print a line for name at depth. Below the root of absolute paths, names
+// are styled as the path components they are.
+static bool print_name(struct tree *tree,
+                       const struct string_view *name,
+                       size_t depth,
+                       bool rooted) {
+  memset(bytes_extend(tree->output, depth * TREE_INDENT), ' ', depth * TREE_INDENT);
+  if (is_root(name)) {
+    render_tree_root(tree->renderer, tree->output);
+  } else {
+    render_tree_name(tree->renderer, tree->output, name->data, name->length, depth - rooted);
+  }
+  bytes_append(tree->output, tree->terminator->data, tree->terminator->length);
+  if (bytes_size(tree->output) >= TREE_OUTPUT_SIZE) {
+    return flush_output(tree->out, tree->output);
+  }
+  return true;
+}
+
+static bool print_trie(struct tree *tree) {
+  struct vector *stack = vector_create(tree->trie_arena, sizeof(struct frame));
+  vector_push(stack);
+  bool rooted = false;
+  while (vector_size(stack)) {
+    size_t depth = vector_size(stack) - 1;
+    struct frame *frame = vector_get(stack, depth);
+    const struct node *node = pool_get(&tree->nodes, frame->node);
+    if (frame->next == node->child_count) {
+      vector_truncate(stack, depth);
+      continue;
+    }
+    uint32_t child = node->children[frame->next++];
+    const struct node *child_node = pool_get(&tree->nodes, child);
+    const struct string_view *name = pool_get(&tree->names, child_node->name);
+    if (!depth) {
+      rooted = is_root(name);
+    }
+    if (!print_name(tree, name, depth, rooted)) {
+      return false;
+    }
+    struct frame *next = vector_push(stack);
+    next->node = child;
+  }
+  return true;
+}
+
+// Split path into the names shown in the tree. The home directory becomes ~
+// when compacting, and the root is left out when stripping leading
+// separators.
+static void split_path(struct tree *tree, const char *path, size_t length) {
+  const char *end = path + length;
+  vector_truncate(tree->components, 0);
+  size_t home_length = render_home_prefix(tree->renderer, path, length);
+  if (home_length) {
+    *(struct string_view *)vector_push(tree->components) = HOME;
+    path += home_length;
+  } else if (path < end && *path == '/' && !tree->config->strip_leading) {
+    *(struct string_view *)vector_push(tree->components) = ROOT;
+  }
+  while (path < end) {
+    const char *sep = memchr(path, '/', end - path);
+    if (!sep) {
+      sep = end;
+    }
+    if (sep != path) {
+      struct string_view *name = vector_push(tree->components);
+      name->data = path;
+      name->length = sep - path;
+    }
+    if (sep == end) {
+      break;
+    }
+    path = sep + 1;
+  }
+}
+
+// Add the current path to the trie, noting whether it enters a directory that
+// an earlier path already left
+static void gather_path(struct tree *tree) {
+  uint32_t parent = 0;
+  bool on_branch = true;
+  for (size_t i = 0; i < vector_size(tree->components); i++) {
+    uint32_t name = intern_name(tree, vector_get(tree->components, i));
+    uint32_t child = find_child(tree, parent, name);
+    if (on_branch
+        && (i >= vector_size(tree->branch)
+            || *(uint32_t *)vector_get(tree->branch, i) != child)) {
+      on_branch = false;
+      vector_truncate(tree->branch, i);
+      if (child) {
+        tree->grouped = false;
+      }
+    }
+    if (!child) {
+      child = add_child(tree, parent, name);
+    }
+    if (!on_branch) {
+      *(uint32_t *)vector_push(tree->branch) = child;
+    }
+    parent = child;
+  }
+}
+
+// Print the names of the current path below the directories it shares with
+// the previous one
+static bool stream_path(struct tree *tree) {
+  size_t count = vector_size(tree->components);
+  size_t depth = 0;
+  for (; depth < count && depth < vector_size(tree->levels); depth++) {
+    const struct level *level = vector_get(tree->levels, depth);
+    const struct string_view *name = vector_get(tree->components, depth);
+    if (level->length != name->length
+        || memcmp(bytes_data(tree->level_names) + level->offset, name->data, name->length)) {
+      break;
+    }
+  }
+  if (depth == count) {
+    return true;
+  }
+  if (depth < vector_size(tree->levels)) {
+    const struct level *level = vector_get(tree->levels, depth);
+    bytes_truncate(tree->level_names, level->offset);
+    vector_truncate(tree->levels, depth);
+  }
+  bool rooted = is_root(vector_get(tree->components, 0));
+  for (; depth < count; depth++) {
+    const struct string_view *name = vector_get(tree->components, depth);
+    struct level *level = vector_push(tree->levels);
+    level->offset = bytes_size(tree->level_names);
+    level->length = name->length;
+    bytes_append(tree->level_names, name->data, name->length);
+    if (!print_name(tree, name, depth, rooted)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Print the trie and continue from the directories of the last path
+static bool start_streaming(struct tree *tree) {
+  if (!print_trie(tree)) {
+    return false;
+  }
+  for (size_t i = 0; i < vector_size(tree->branch); i++) {
+    const struct node *node = pool_get(&tree->nodes, *(uint32_t *)vector_get(tree->branch, i));
+    const struct string_view *name = pool_get(&tree->names, node->name);
+    struct level *level = vector_push(tree->levels);
+    level->offset = bytes_size(tree->level_names);
+    level->length = name->length;
+    bytes_append(tree->level_names, name->data, name->length);
+  }
+  free_trie(tree);
+  tree->streaming = true;
+  return true;
+}
+
+static bool add_path(struct tree *tree, const char *path, size_t length) {
+  split_path(tree, path, length);
+  if (!vector_size(tree->components)) {
+    return true;
+  }
+  if (tree->streaming) {
+    return stream_path(tree);
+  }
+  gather_path(tree);
+  if (++tree->path_count == TREE_WINDOW && tree->grouped) {
+    return start_streaming(tree);
+  }
+  return true;
+}
+
+// Add the paths read from in. Records longer than the input buffer cannot be
+// paths and are skipped.
+bool tree_read(struct tree *tree, int in, char delimiter) {
+  bool ret = false;
+  char *buffer = check(malloc(TREE_BUFFER_SIZE));
+  size_t length = 0;
+  bool skipping = false; // Whether the current record is being skipped
+  while (true) {
+    ssize_t count = read(in, buffer + length, TREE_BUFFER_SIZE - length);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      goto out;
+    }
+    length += count;
+    const char *end = buffer + length;
+    const char *pos = buffer;
+    const char *delim;
+    while ((delim = memchr(pos, delimiter, end - pos))) {
+      if (skipping) {
+        skipping = false;
+      } else if (!add_path(tree, pos, delim - pos)) {
+        goto out;
+      }
+      pos = delim + 1;
+    }
+    length = end - pos;
+    if (count == 0) {
+      if (!skipping && length && !add_path(tree, pos, length)) {
+        goto out;
+      }
+      break;
+    }
+    if (length == TREE_BUFFER_SIZE) {
+      skipping = true;
+      length = 0;
+    } else {
+      memmove(buffer, pos, length);
+    }
+  }
+  ret = true;
+ out:
+  free(buffer);
+  return ret;
+}
+
+// Print the paths that are still gathered and write out the rest of the
+// output
+bool tree_finish(struct tree *tree) {
+  if (!tree->streaming && !print_trie(tree)) {
+    return false;
+  }
+  return flush_output(tree->out, tree->output);
+}
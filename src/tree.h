@@ -0,0 +1,20 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <stdbool.h>
+
+#include "config.h"
+#include "parser_common.h"
+#include "render.h"
+
+struct tree;
+
+struct tree *tree_create(const struct renderer *renderer,
+                         const struct config *config,
+                         int out,
+                         const struct string_view *terminator);
+bool tree_read(struct tree *tree, int in, char delimiter);
+bool tree_finish(struct tree *tree);
+void tree_free(struct tree *tree);
+
+#endif
@@ -5,12 +5,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <pwd.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <string.h>
-#include <linux/limits.h>
-
+#include <pthread.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 void fatal(const char *message) {
   fprintf(stderr, "%s\n", message);
@@ -36,40 +37,79 @@ char *check_asprintf(const char *fmt, ...) {
   return str;
 }
 
-bool read_stream(FILE *stream, char **data, size_t *length) {
-  size_t capacity = getpagesize();
-  size_t available = capacity;
-  size_t offset = 0;
+// Read the contents of fd, whose status is in buf. Regular files are mapped
+// into memory, anything else is read into a buffer sized after the file,
+// which only has to grow for special files that do not report their size.
+bool map_file(int fd, const struct stat *buf, struct mapped_file *file) {
+  if (S_ISREG(buf->st_mode) && buf->st_size > 0) {
+    void *data = mmap(NULL, buf->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      file->data = data;
+      file->length = buf->st_size;
+      file->mapped = true;
+      return true;
+    }
+  }
+  size_t capacity = buf->st_size > 0 ? (size_t)buf->st_size + 1 : (size_t)getpagesize();
+  size_t length = 0;
   char *buffer = check(malloc(capacity));
   while (true) {
-    size_t read = fread(buffer + offset, 1, available, stream);
-    offset += read;
-    if (read != available) {
-      break;
-    }
-    capacity *= 2;
-    char *buf = check(realloc(buffer, capacity));
-    if (!buf) {
+    ssize_t count = read(fd, buffer + length, capacity - length);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
       free(buffer);
       return false;
     }
-    buffer = buf;
-    available = capacity - offset;
-  }
-  if (ferror(stream)) {
-    free(buffer);
-    return false;
+    if (count == 0) {
+      break;
+    }
+    length += count;
+    if (length == capacity) {
+      capacity *= 2;
+      buffer = check(realloc(buffer, capacity));
+    }
   }
-  *data = buffer;
-  *length = offset;
+  file->data = buffer;
+  file->length = length;
+  file->mapped = false;
   return true;
 }
 
+void unmap_file(struct mapped_file *file) {
+  if (file->mapped) {
+    munmap((void *)file->data, file->length);
+  } else {
+    free((void *)file->data);
+  }
+}
+
+// Prefer $PWD when it still refers to the working directory. This avoids
+// getcwd and keeps the logical path the shell displays.
+static char *get_pwd(void) {
+  const char *pwd = get_env("PWD");
+  struct stat pwd_buf;
+  struct stat cwd_buf;
+  if (!pwd || *pwd != '/'
+      || stat(pwd, &pwd_buf) != 0
+      || stat(".", &cwd_buf) != 0
+      || pwd_buf.st_dev != cwd_buf.st_dev
+      || pwd_buf.st_ino != cwd_buf.st_ino) {
+    return NULL;
+  }
+  return check(strdup(pwd));
+}
+
 char *get_working_directory(void) {
-  size_t buffer_size = PATH_MAX;
+  char *pwd = get_pwd();
+  if (pwd) {
+    return pwd;
+  }
+  size_t buffer_size = 256;
   char *buffer = check(malloc(buffer_size));
   while (true) {
-    if ((buffer = getcwd(buffer, buffer_size))) {
+    if (getcwd(buffer, buffer_size)) {
       return buffer;
     } else if (errno == ERANGE) {
       buffer_size *= 2;
@@ -81,17 +121,101 @@ char *get_working_directory(void) {
   }
 }
 
-const char *get_home_directory(void) {
-  char *home = getenv("HOME");
-  if (!home) {
-    struct passwd *info = getpwuid(getuid());
-    if (info) {
-      home = info->pw_dir;
+char *get_process_working_directory(pid_t pid) {
+  char *link = check_asprintf("/proc/%ld/cwd", (long)pid);
+  size_t buffer_size = 256;
+  char *buffer = check(malloc(buffer_size));
+  while (true) {
+    ssize_t length = readlink(link, buffer, buffer_size);
+    if (length < 0) {
+      free(buffer);
+      buffer = NULL;
+      break;
+    } else if ((size_t)length < buffer_size) {
+      buffer[length] = '\0';
+      break;
+    }
+    buffer_size *= 2;
+    buffer = check(realloc(buffer, buffer_size));
+  }
+  free(link);
+  return buffer;
+}
+
+char *read_first_line(const char *path) {
+  FILE *handle = fopen(path, "re");
+  if (!handle) {
+    return NULL;
+  }
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t length = getline(&line, &line_size, handle);
+  fclose(handle);
+  if (length <= 0) {
+    free(line);
+    return NULL;
+  }
+  line[strcspn(line, "\n")] = '\0';
+  return line;
+}
+
+// Look up the home directory from the password file directly instead of
+// going through getpwuid, which loads NSS modules.
+static char *read_passwd_home(uid_t uid) {
+  FILE *passwd = fopen("/etc/passwd", "re");
+  if (!passwd) {
+    return NULL;
+  }
+  char *home = NULL;
+  char *line = NULL;
+  size_t line_size = 0;
+  while (!home && getline(&line, &line_size, passwd) != -1) {
+    // name:password:uid:gid:gecos:home:shell
+    char *fields[7];
+    char *rest = line;
+    size_t count = 0;
+    line[strcspn(line, "\n")] = '\0';
+    while (rest && count < ARRAY_SIZE(fields)) {
+      fields[count++] = strsep(&rest, ":");
+    }
+    char *uid_end;
+    if (count >= 6
+        && strtoul(fields[2], &uid_end, 10) == uid
+        && uid_end != fields[2]
+        && *uid_end == '\0') {
+      home = check(strdup(fields[5]));
     }
   }
+  free(line);
+  fclose(passwd);
   return home;
 }
 
+static const char *home_directory = NULL;
+static pthread_once_t home_directory_once = PTHREAD_ONCE_INIT;
+
+// Users from other sources, such as LDAP or systemd-homed, are not in the
+// password file and are looked up through NSS instead
+static void resolve_home_directory(void) {
+  home_directory = getenv("HOME");
+  if (!home_directory) {
+    home_directory = read_passwd_home(getuid());
+  }
+  if (!home_directory) {
+    struct passwd *passwd = getpwuid(getuid());
+    if (passwd && passwd->pw_dir) {
+      home_directory = check(strdup(passwd->pw_dir));
+    }
+  }
+}
+
+// The home directory is resolved once, also when first needed by the thread
+// loading the configuration under a deadline
+const char *get_home_directory(void) {
+  pthread_once(&home_directory_once, resolve_home_directory);
+  return home_directory;
+}
+
 const char *get_env(const char *var) {
   char *value = getenv(var);
   if (!value || !strcmp(value, "")) {
@@ -99,3 +223,48 @@ const char *get_env(const char *var) {
   }
   return value;
 }
+
+char *get_cache_directory(void) {
+  const char *xdg_cache_home = get_env("XDG_CACHE_HOME");
+  if (xdg_cache_home) {
+    return check_asprintf("%s/" PACKAGE_NAME, xdg_cache_home);
+  }
+  const char *home = get_home_directory();
+  if (!home) {
+    return NULL;
+  }
+  return check_asprintf("%s/.cache/" PACKAGE_NAME, home);
+}
+
+bool make_directories(const char *path) {
+  char *copy = check(strdup(path));
+  for (char *pos = copy + 1; *pos; pos++) {
+    if (*pos != '/') {
+      continue;
+    }
+    *pos = '\0';
+    if (mkdir(copy, 0700) != 0 && errno != EEXIST) {
+      free(copy);
+      return false;
+    }
+    *pos = '/';
+  }
+  free(copy);
+  return mkdir(path, 0700) == 0 || errno == EEXIST;
+}
+
+bool write_all(int fd, const void *data, size_t length) {
+  const char *pos = data;
+  while (length > 0) {
+    ssize_t written = write(fd, pos, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    pos += written;
+    length -= written;
+  }
+  return true;
+}
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
 #define UNUSED __attribute__((unused))
@@ -14,10 +16,23 @@ void *check(void *ptr);
 char *check_asprintf(const char *fmt, ...);
 
 char *get_working_directory(void);
+char *get_process_working_directory(pid_t pid);
+char *read_first_line(const char *path);
 const char *get_home_directory(void);
 
-bool read_stream(FILE *stream, char **data, size_t *length);
+struct mapped_file {
+  const char *data;
+  size_t length;
+  bool mapped; // Whether data is mapped or allocated with malloc
+};
+
+bool map_file(int fd, const struct stat *buf, struct mapped_file *file);
+void unmap_file(struct mapped_file *file);
 
 const char *get_env(const char *var);
 
+char *get_cache_directory(void);
+bool make_directories(const char *path);
+bool write_all(int fd, const void *data, size_t length);
+
 #endif
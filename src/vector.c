@@ -0,0 +1,68 @@
+#include "vector.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "utils.h"
+
+enum {
+  INITIAL_VECTOR_CAP = 8
+};
+
+struct vector *vector_create(struct arena *arena, size_t elem_size) {
+  struct vector *vector = arena_alloc(arena, sizeof(*vector));
+  vector_init(vector, arena, elem_size);
+  return vector;
+}
+
+void vector_init(struct vector *vector, struct arena *arena, size_t elem_size) {
+  vector->arena = arena;
+  vector->data = NULL;
+  vector->size = 0;
+  vector->cap = 0;
+  vector->elem_size = elem_size;
+}
+
+// Make room for at least count more elements
+static void vector_reserve(struct vector *vector, size_t count) {
+  assert(vector->arena);
+  if (vector->cap - vector->size >= count) {
+    return;
+  }
+  size_t new_cap = vector->cap ? vector->cap : INITIAL_VECTOR_CAP;
+  while (new_cap - vector->size < count) {
+    if (new_cap > SIZE_MAX / 2) {
+      fatal("Failed to allocate memory");
+    }
+    new_cap *= 2;
+  }
+  if (new_cap > SIZE_MAX / vector->elem_size) {
+    fatal("Failed to allocate memory");
+  }
+  vector->data = arena_grow(vector->arena,
+                            vector->data,
+                            vector->size * vector->elem_size,
+                            new_cap * vector->elem_size);
+  vector->cap = new_cap;
+}
+
+// Append a zeroed element and return it
+void *vector_push(struct vector *vector) {
+  vector_reserve(vector, 1);
+  void *elem = vector_get(vector, vector->size);
+  memset(elem, 0, vector->elem_size);
+  vector->size++;
+  return elem;
+}
+
+// Append the elements of other
+void vector_extend(struct vector *vector, const struct vector *other) {
+  assert(vector->elem_size == other->elem_size);
+  if (!other->size) {
+    return;
+  }
+  vector_reserve(vector, other->size);
+  memcpy(vector_get(vector, vector->size), other->data, other->size * other->elem_size);
+  vector->size += other->size;
+}
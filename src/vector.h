@@ -0,0 +1,46 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stddef.h>
+
+#include "arena.h"
+
+// Contiguous array of fixed size elements stored by value. Growing vectors
+// allocate from an arena, vectors without one wrap a static array.
+struct vector {
+  struct arena *arena;
+  void *data;
+  size_t size;
+  size_t cap;
+  size_t elem_size;
+};
+
+#define STATIC_VECTOR(array) {                  \
+    .arena = NULL,                              \
+    .data = array,                              \
+    .size = sizeof(array) / sizeof(array[0]),   \
+    .cap = sizeof(array) / sizeof(array[0]),    \
+    .elem_size = sizeof(array[0]),              \
+  }
+
+struct vector *vector_create(struct arena *arena, size_t elem_size);
+void vector_init(struct vector *vector, struct arena *arena, size_t elem_size);
+void *vector_push(struct vector *vector);
+void vector_extend(struct vector *vector, const struct vector *other);
+
+static inline size_t vector_size(const struct vector *vector) {
+  return vector->size;
+}
+
+// Drop the elements from size onwards
+static inline void vector_truncate(struct vector *vector, size_t size) {
+  if (size < vector->size) {
+    vector->size = size;
+  }
+}
+
+static inline void *vector_get(const struct vector *vector, size_t index) {
+  return (char *)vector->data + index * vector->elem_size;
+}
+
+#endif
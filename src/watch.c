@@ -0,0 +1,120 @@
+#include "watch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+#include "utils.h"
+
+// Files are watched through their parent directories so that files replaced
+// by renaming a new version over them, as editors tend to do, or files that
+// do not exist yet are noticed as well.
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+
+struct watch_entry {
+  int wd;
+  char *name;
+  enum watch_event event;
+};
+
+struct watch {
+  int fd;
+  struct watch_entry entries[4]; // Configuration files and the target
+  size_t entry_count;
+};
+
+struct watch *watch_create(void) {
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct watch *watch = check(calloc(1, sizeof(*watch)));
+  watch->fd = fd;
+  return watch;
+}
+
+bool watch_add(struct watch *watch, const char *path, enum watch_event event) {
+  if (watch->entry_count >= ARRAY_SIZE(watch->entries)) {
+    return false;
+  }
+  const char *slash = strrchr(path, '/');
+  char *directory;
+  if (!slash) {
+    directory = check(strdup("."));
+  } else if (slash == path) {
+    directory = check(strdup("/"));
+  } else {
+    directory = check(strndup(path, slash - path));
+  }
+  int wd = inotify_add_watch(watch->fd, directory, WATCH_MASK);
+  free(directory);
+  if (wd < 0) {
+    return false;
+  }
+  struct watch_entry *entry = &watch->entries[watch->entry_count++];
+  entry->wd = wd;
+  entry->name = check(strdup(slash ? slash + 1 : path));
+  entry->event = event;
+  return true;
+}
+
+static unsigned int match_event(const struct watch *watch,
+                                const struct inotify_event *event) {
+  unsigned int events = 0;
+  for (size_t i = 0; i < watch->entry_count; i++) {
+    const struct watch_entry *entry = &watch->entries[i];
+    if (entry->wd == event->wd
+        && event->len
+        && !strcmp(entry->name, event->name)) {
+      events |= entry->event;
+    }
+  }
+  return events;
+}
+
+// Block until a watched file changes or until timeout milliseconds have
+// passed. A negative timeout waits indefinitely. With a timeout, events are
+// set to zero when it expires or when only unrelated files changed.
+bool watch_wait(struct watch *watch, int timeout, unsigned int *events) {
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct pollfd pollfd = { .fd = watch->fd, .events = POLLIN };
+  *events = 0;
+  do {
+    int ready = poll(&pollfd, 1, timeout);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (ready == 0) {
+      return true;
+    }
+    ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+    if (length < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      return false;
+    }
+    const char *pos = buffer;
+    while (pos < buffer + length) {
+      const struct inotify_event *event = (const struct inotify_event *)pos;
+      *events |= match_event(watch, event);
+      pos += sizeof(*event) + event->len;
+    }
+  } while (!*events && timeout < 0);
+  return true;
+}
+
+void watch_free(struct watch *watch) {
+  for (size_t i = 0; i < watch->entry_count; i++) {
+    free(watch->entries[i].name);
+  }
+  close(watch->fd);
+  free(watch);
+}
@@ -0,0 +1,18 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdbool.h>
+
+enum watch_event {
+  WATCH_EVENT_CONFIG = 1 << 0,
+  WATCH_EVENT_TARGET = 1 << 1,
+};
+
+struct watch;
+
+struct watch *watch_create(void);
+bool watch_add(struct watch *watch, const char *path, enum watch_event event);
+bool watch_wait(struct watch *watch, int timeout, unsigned int *events);
+void watch_free(struct watch *watch);
+
+#endif
@@ -71,3 +71,15 @@ compact = true
 # Override the style for the last path component.
 override[-1] = "bold"
 '
+
+should_report() {
+    local message
+    if message="$(echo -n "$2" | "$TEST_PARSER" "$1" 2>&1 > /dev/null)"; then
+        return 1
+    fi
+    [[ $message == "$3" ]]
+}
+
+# Errors are reported with the line and column where they occur
+should_report config $'compact = true\n  method "hash"' "Line 2, column 10: Expected '='"
+should_report config $'# Comment\n\npalette = "fg=1' "Line 3, column 16: Unterminated string"
@@ -0,0 +1,323 @@
+#!/usr/bin/env bash
+
+set -e
+
+# Paths read from standard input or a file and paths given together must be
+# rendered exactly like paths given one at a time.
+
+workdir="$(mktemp -d)"
+trap 'rm -rf "$workdir"' EXIT
+
+export HOME="$workdir/home"
+export TERM=xterm-256color
+unset XDG_CACHE_HOME XDG_CONFIG_HOME XDG_CONFIG_DIRS RAINBOWPATH_SNAPSHOT
+mkdir "$HOME"
+
+paths=(
+    "/"
+    "/usr/local/share"
+    "relative/path/"
+    "//double//separators"
+    "$HOME"
+    "$HOME/projects/rainbowpath"
+    "a path/with spaces"
+)
+
+options=(-c -o -1 bold -O 0 underlined)
+
+expected="$workdir/expected"
+for path in "${paths[@]}"; do
+    "$RAINBOWPATH" "${options[@]}" "$path"
+done > "$expected"
+
+printf '%s\n' "${paths[@]}" | "$RAINBOWPATH" --stdin "${options[@]}" > "$workdir/lines"
+cmp "$expected" "$workdir/lines"
+
+printf '%s\0' "${paths[@]}" | "$RAINBOWPATH" --stdin -0 "${options[@]}" | tr '\0' '\n' > "$workdir/null"
+cmp "$expected" "$workdir/null"
+
+printf '%s\n' "${paths[@]}" > "$workdir/paths"
+"$RAINBOWPATH" --from-file "$workdir/paths" "${options[@]}" > "$workdir/file"
+cmp "$expected" "$workdir/file"
+
+# Files given with --input are rendered one after another
+cat "$expected" "$expected" > "$workdir/twice"
+"$RAINBOWPATH" --input "${options[@]}" "$workdir/paths" "$workdir/paths" > "$workdir/input"
+cmp "$workdir/twice" "$workdir/input"
+
+"$RAINBOWPATH" "${options[@]}" -- "${paths[@]}" > "$workdir/arguments"
+cmp "$expected" "$workdir/arguments"
+
+# Options after the first PATH are rejected rather than taken for paths,
+# unless the paths follow --
+should_fail() {
+    ! "$RAINBOWPATH" "$@" > /dev/null 2>&1
+}
+should_fail /usr/lib -m hash
+should_fail --input "$workdir/paths" -m hash
+"$RAINBOWPATH" -- /usr/lib -m > /dev/null
+
+# Output reused between paths that share leading directories must match
+# rendering each path on its own, also with overrides counted from the end
+nested=(/usr /usr/lib /usr/lib/a /usr/lib/a/b /usr/lib/b /usr/lib//c/ /usr/share
+        "$HOME/x" "$HOME/x/y" "$HOME/x/y" /usr)
+"$RAINBOWPATH" "${options[@]}" -o -2 dim -- "${nested[@]}" > "$workdir/nested"
+printf '%s\n' "${nested[@]}" \
+    | "$RAINBOWPATH" --stdin "${options[@]}" -o -2 dim \
+    | cmp "$workdir/nested" -
+
+# Styles selected by hash are reused for names that repeat within a stream
+"$RAINBOWPATH" -m hash -- "${paths[@]}" "${paths[@]}" > "$workdir/hash"
+printf '%s\n' "${paths[@]}" "${paths[@]}" \
+    | "$RAINBOWPATH" -m hash --stdin --stats 2> "$workdir/stats" \
+    | cmp "$workdir/hash" -
+grep -q '^Component cache: [1-9][0-9]* hits, [1-9][0-9]* misses$' "$workdir/stats"
+
+# Records too long to be paths are copied unchanged
+head -c 1000000 /dev/zero | tr '\0' 'x' > "$workdir/long"
+echo >> "$workdir/long"
+"$RAINBOWPATH" --stdin < "$workdir/long" | cmp "$workdir/long" -
+"$RAINBOWPATH" --input "$workdir/long" | cmp "$workdir/long" -
+
+# Rendering on several threads must not change the output, even for inputs
+# spanning many chunks and records longer than a chunk
+for i in $(seq 2000); do
+    printf '%s\n' "${paths[@]}"
+done > "$workdir/many"
+cat "$workdir/long" "$workdir/many" "$workdir/long" "$workdir/many" > "$workdir/mixed"
+"$RAINBOWPATH" --stdin "${options[@]}" < "$workdir/mixed" > "$workdir/serial"
+"$RAINBOWPATH" --stdin --jobs 4 "${options[@]}" < "$workdir/mixed" | cmp "$workdir/serial" -
+"$RAINBOWPATH" --input "${options[@]}" "$workdir/mixed" | cmp "$workdir/serial" -
+
+# Trees show each directory once below its parent, in the order in which it
+# first appears
+strip_styles() {
+    sed $'s/\e\\[[0-9;]*m//g; s/\e(B//g'
+}
+printf '%s\n' /a/b /d/e /a/c/f "$HOME/x" | "$RAINBOWPATH" --tree -c | strip_styles > "$workdir/tree"
+printf '%s\n' / '  a' '    b' '    c' '      f' '  d' '    e' '~' '  x' | cmp "$workdir/tree" -
+
+# Grouped input is printed while it is read, and must give the same tree as
+# input that has to be gathered first
+seq 100000 | awk '{ print "/d" int($1 / 100) "/f" $1 }' > "$workdir/grouped"
+printf '%s\n' /x/1 /y /x/2 | cat - "$workdir/grouped" > "$workdir/ungrouped"
+"$RAINBOWPATH" --tree < "$workdir/grouped" | tail -n +2 > "$workdir/streamed"
+"$RAINBOWPATH" --tree --input "$workdir/ungrouped" | tail -n +6 | cmp "$workdir/streamed" -
+
+# Once grouped input is being printed, a directory that comes up again is
+# shown again below its parent
+{ cat "$workdir/grouped"; echo /d1/late; } | "$RAINBOWPATH" --tree | strip_styles \
+    | tail -n 4 | cmp <(printf '%s\n' '  d1000' '    f100000' '  d1' '    late') -
+
+# Paths found within text are rendered like paths given on their own, and
+# everything around them is copied unchanged
+render() {
+    "$RAINBOWPATH" -n "${options[@]}" "$1"
+}
+printf '%s\n' 'src/render.c:12:5: see "/usr/local/share" and 2024/01/02.' \
+    'https://example.com/a/b' "$HOME/x (y/z)" 'no paths' > "$workdir/text"
+{
+    printf '%s:12:5: see "%s" and 2024/01/02.\n' "$(render src/render.c)" "$(render /usr/local/share)"
+    printf '%s\n' 'https://example.com/a/b'
+    printf '%s (%s)\n' "$(render "$HOME/x")" "$(render y/z)"
+    printf '%s\n' 'no paths'
+} > "$workdir/highlighted"
+"$RAINBOWPATH" --highlight-paths "${options[@]}" < "$workdir/text" | cmp "$workdir/highlighted" -
+"$RAINBOWPATH" --highlight-paths < "$workdir/text" | strip_styles | cmp "$workdir/text" -
+
+# Only the selected field is rendered, and records without it are copied
+# unchanged
+printf '12\t%s\t%s\n' /usr/lib "$(render /usr/lib)" "$HOME/a b" "$(render "$HOME/a b")" \
+    > "$workdir/fields"
+cut -f 1,2 "$workdir/fields" > "$workdir/du"
+echo 'no fields' >> "$workdir/du"
+{ cut -f 1,3 "$workdir/fields"; echo 'no fields'; } > "$workdir/rendered"
+"$RAINBOWPATH" --field 2 --delimiter '\t' "${options[@]}" < "$workdir/du" | cmp "$workdir/rendered" -
+printf '  4  %s x\n' /usr/lib | "$RAINBOWPATH" --field 2 "${options[@]}" \
+    | cmp <(printf '  4  %s x\n' "$(render /usr/lib)") -
+
+# LS_COLORS styles the last component by the longest matching suffix or by
+# its file type, also when output is reused between paths
+mkdir -p "$workdir/files/dir"
+touch "$workdir/files/dir/file.tar.gz"
+colored=("$workdir/files/dir/" "$workdir/files/dir/file.tar.gz" "$workdir/files/dir"
+         "$workdir/files/dir/" /a/b.gz /a/b.gz/c)
+export LS_COLORS='di=01;34:*.gz=32:*.tar.gz=01;31'
+"$RAINBOWPATH" --ls-colors "${options[@]}" -- "${colored[@]}" > "$workdir/colored"
+printf '%s\n' "${colored[@]}" | "$RAINBOWPATH" --ls-colors --stdin "${options[@]}" \
+    | cmp "$workdir/colored" -
+grep -q $'\e\\[01;31mfile.tar.gz' "$workdir/colored"
+grep -q $'\e\\[01;34mdir' "$workdir/colored"
+grep -q $'\e\\[32mb.gz' "$workdir/colored"
+# Directories are not styled by suffix, even without a di entry
+LS_COLORS='*.gz=32' "$RAINBOWPATH" --ls-colors /a/b.gz/ | cmp <("$RAINBOWPATH" /a/b.gz/) -
+unset LS_COLORS
+
+# Paths of a live stream are written as soon as input pauses rather than
+# once the output buffer fills up, and a latency bound leaves output the same
+for jobs in 1 4; do
+    { printf '%s\n' /usr/lib; sleep 3; } \
+        | "$RAINBOWPATH" --stdin --jobs "$jobs" "${options[@]}" \
+        | { IFS= read -r -t 2 line && [[ $line == "$(render /usr/lib)" ]]; }
+done
+cat "$workdir/mixed" | "$RAINBOWPATH" --stdin --max-latency 1ms "${options[@]}" \
+    | cmp "$workdir/serial" -
+
+# A theme given on the command line replaces both palettes of the
+# configuration file
+"$RAINBOWPATH" --theme nord /usr/lib > "$workdir/themed"
+printf 'palette = "fg=1"\nseparator-palette = "fg=2"\n' > "$HOME/.rainbowpath.conf"
+"$RAINBOWPATH" --theme nord /usr/lib | cmp "$workdir/themed" -
+rm "$HOME/.rainbowpath.conf"
+
+# The parsed configuration file is cached, and the cache is only used while it
+# matches the file. Output must be the same as when parsing the file anew.
+cache="$HOME/.cache/rainbowpath"
+conf="$HOME/.rainbowpath.conf"
+uncached() {
+    rm -rf "$cache"
+    "$RAINBOWPATH" "$@" /usr/lib
+}
+printf 'palette = "fg=1"\noverride[-1] = "bold"\n' > "$conf"
+uncached > "$workdir/uncached"
+ls "$cache"/config-*.cache > /dev/null
+"$RAINBOWPATH" /usr/lib | cmp "$workdir/uncached" -
+
+# Edits invalidate the cache, also when the size of the file stays the same
+printf 'palette = "fg=12"\n' > "$conf"
+"$RAINBOWPATH" /usr/lib > "$workdir/cached"
+uncached | cmp "$workdir/cached" -
+! cmp -s "$workdir/uncached" "$workdir/cached" || exit 1
+printf 'palette = "fg=13"\n' > "$conf"
+touch -d '2001-01-01' "$conf"
+"$RAINBOWPATH" /usr/lib > "$workdir/cached"
+uncached | cmp "$workdir/cached" -
+
+# Truncated and corrupt cache files are ignored
+uncached > "$workdir/uncached"
+for cache_file in "$cache"/config-*.cache; do
+    truncate -s 20 "$cache_file"
+    "$RAINBOWPATH" /usr/lib | cmp "$workdir/uncached" -
+    head -c 512 /dev/urandom > "$cache_file"
+    "$RAINBOWPATH" /usr/lib | cmp "$workdir/uncached" -
+done
+
+# Options given on the command line are not cached as part of the file
+uncached -p 'fg=5' > /dev/null
+"$RAINBOWPATH" /usr/lib | cmp "$workdir/uncached" -
+rm -rf "$cache" "$conf"
+
+# A snapshot is used instead of the configuration file as long as the
+# environment it was taken in stays the same. Snapshots taken elsewhere and
+# ones that cannot be decoded are ignored.
+printf 'palette = "fg=1"\n' > "$conf"
+"$RAINBOWPATH" /usr/lib > "$workdir/snapshot"
+snapshot="$("$RAINBOWPATH" --snapshot)"
+printf 'palette = "fg=2"\n' > "$conf"
+"$RAINBOWPATH" /usr/lib > "$workdir/edited"
+RAINBOWPATH_SNAPSHOT="$snapshot" "$RAINBOWPATH" /usr/lib | cmp "$workdir/snapshot" -
+RAINBOWPATH_SNAPSHOT="$snapshot" XDG_CONFIG_HOME="$workdir/config" "$RAINBOWPATH" /usr/lib \
+    | cmp "$workdir/edited" -
+mkdir -p "$workdir/other"
+cp "$conf" "$workdir/other/"
+RAINBOWPATH_SNAPSHOT="$snapshot" HOME="$workdir/other" "$RAINBOWPATH" /usr/lib \
+    | cmp "$workdir/edited" -
+for malformed in 'not base64' "${snapshot:0:${#snapshot}-1}" 'AAAA' "${snapshot%?}*"; do
+    RAINBOWPATH_SNAPSHOT="$malformed" "$RAINBOWPATH" /usr/lib | cmp "$workdir/edited" -
+done
+rm -rf "$cache" "$conf"
+
+# Work abandoned once the deadline expires falls back to defaults: a terminal
+# entry that blocks when opened leaves styles to the built-in ones, and a path
+# file that blocks is reported instead of hanging
+mkdir -p "$workdir/terminfo/x"
+mkfifo "$workdir/terminfo/x/xterm-256color" "$workdir/blocked"
+TERMINFO="$workdir/terminfo" timeout 10 "$RAINBOWPATH" --deadline 50ms /usr/lib \
+    | strip_styles | cmp <(echo /usr/lib) -
+status=0
+timeout 10 "$RAINBOWPATH" --deadline 50ms --path-file "$workdir/blocked" 2> /dev/null \
+    || status=$?
+(( status == 1 ))
+
+# Invalid values and unknown options in the configuration file are reported
+# with their line and column
+printf 'compact = true\npalette = "fg=300"\n' > "$conf"
+! "$RAINBOWPATH" /usr/lib 2> "$workdir/errors" > /dev/null || exit 1
+grep -qx "Line 2, column 11: Invalid value for option 'palette'" "$workdir/errors"
+printf '\n  colour = true\n' > "$conf"
+! "$RAINBOWPATH" /usr/lib 2> "$workdir/errors" > /dev/null || exit 1
+grep -qx "Line 2, column 3: Invalid option 'colour'" "$workdir/errors"
+
+# Options given on the command line take precedence over the same options in
+# the configuration file, and overrides from the command line apply last
+printf '%s\n' 'separator = ":"' 'method = "hash"' 'palette = "fg=1; fg=2"' \
+    'override[-1] = "fg=3"' > "$conf"
+"$RAINBOWPATH" -S '|' -m sequential -p 'fg=4; fg=5' -o -1 'fg=6' /usr/lib/x > "$workdir/precedence"
+rm -rf "$cache" "$conf"
+"$RAINBOWPATH" -S '|' -m sequential -p 'fg=4; fg=5' -o -1 'fg=6' /usr/lib/x \
+    | cmp "$workdir/precedence" -
+
+# Watch mode prints the path again whenever the path file is rewritten or
+# replaced, and whenever a configuration file is created or changed, also in
+# the configuration directory. An invalid configuration keeps the previous
+# one in use.
+printf 'palette = "fg=1"\n' > "$conf"
+for path in /usr/share /var; do
+    "$RAINBOWPATH" "$path"
+done > "$workdir/configured"
+rm -rf "$cache" "$conf"
+for path in /usr/lib /tmp /usr/share; do
+    "$RAINBOWPATH" "$path"
+done | cat - "$workdir/configured" > "$workdir/watched-paths"
+wait_lines() {
+    for _ in $(seq 200); do
+        if (( $(wc -l < "$1") >= $2 )); then
+            return 0
+        fi
+        sleep 0.05
+    done
+    return 1
+}
+echo /usr/lib > "$workdir/watched"
+mkdir -p "$workdir/xdg/rainbowpath"
+XDG_CONFIG_HOME="$workdir/xdg" "$RAINBOWPATH" --watch --path-file "$workdir/watched" \
+    > "$workdir/watch" 2> /dev/null &
+watcher=$!
+wait_lines "$workdir/watch" 1
+echo /tmp > "$workdir/watched"
+wait_lines "$workdir/watch" 2
+echo /usr/share > "$workdir/watched.new"
+mv "$workdir/watched.new" "$workdir/watched"
+wait_lines "$workdir/watch" 3
+printf 'palette = "fg=1"\n' > "$workdir/xdg/rainbowpath/rainbowpath.conf"
+wait_lines "$workdir/watch" 4
+printf 'palette = "fg=300"\n' > "$workdir/xdg/rainbowpath/rainbowpath.conf"
+sleep 0.2
+echo /var > "$workdir/watched"
+wait_lines "$workdir/watch" 5
+kill "$watcher"
+wait "$watcher" || true
+cmp "$workdir/watched-paths" "$workdir/watch"
+rm -rf "$cache" "$conf"
+
+# random-stable colors each name the same way for a given RAINBOWPATH_SEED,
+# and differently for another seed
+stable=(-m random-stable -p 'fg=1; fg=2; fg=3; fg=4; fg=5; fg=6; fg=7; fg=8' /a/b/c/d/e/f/g/h/i/j/k/l)
+RAINBOWPATH_SEED=first "$RAINBOWPATH" "${stable[@]}" > "$workdir/seeded"
+RAINBOWPATH_SEED=first "$RAINBOWPATH" "${stable[@]}" | cmp "$workdir/seeded" -
+! RAINBOWPATH_SEED=second "$RAINBOWPATH" "${stable[@]}" | cmp -s "$workdir/seeded" - || exit 1
+
+# Every built-in theme can be selected on the command line or in the
+# configuration file, and unknown themes are rejected
+for theme in default solarized nord gruvbox mono; do
+    "$RAINBOWPATH" --theme "$theme" /usr/lib > "$workdir/themed"
+    printf 'theme = "%s"\n' "$theme" > "$conf"
+    "$RAINBOWPATH" /usr/lib | cmp "$workdir/themed" -
+    rm -rf "$cache" "$conf"
+done
+! "$RAINBOWPATH" --theme unknown /usr/lib 2> "$workdir/errors" > /dev/null || exit 1
+grep -qx 'Invalid theme' "$workdir/errors"
+printf 'theme = "unknown"\n' > "$conf"
+! "$RAINBOWPATH" /usr/lib 2> "$workdir/errors" > /dev/null || exit 1
+grep -qx "Line 1, column 9: Invalid value for option 'theme'" "$workdir/errors"
+rm -rf "$cache" "$conf"
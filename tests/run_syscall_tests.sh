@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+
+set -e
+
+# Maximum number of system calls a plain render may make on top of the ones
+# needed by process startup, which are measured using --version.
+BUDGET="${SYSCALL_BUDGET:-20}"
+
+workdir="$(mktemp -d)"
+trap 'rm -rf "$workdir"' EXIT
+
+export HOME="$workdir"
+export PWD="$workdir"
+export TERM=xterm-256color
+unset XDG_CACHE_HOME XDG_CONFIG_HOME XDG_CONFIG_DIRS RAINBOWPATH_SNAPSHOT
+cd "$workdir"
+
+cat > "$HOME/.rainbowpath.conf" <<CONF
+palette = "fg=1; fg=3; fg=2; fg=6; fg=4; fg=5"
+compact = true
+override[-1] = "bold"
+CONF
+
+count() {
+    local result
+    result="$("$SYSCALL_COUNT" "$RAINBOWPATH" "$@")" || exit $?
+    echo "$result"
+}
+
+# Populate caches
+"$RAINBOWPATH" > /dev/null
+
+baseline="$(count --version)"
+render="$(count)"
+echo "Startup: $baseline system calls, render: $render system calls"
+(( render - baseline <= BUDGET ))
@@ -0,0 +1,133 @@
+#!/usr/bin/env bash
+
+set -e
+
+# The built-in terminfo reader must read both entry formats and expand
+# capabilities exactly like ncurses.
+
+workdir="$(mktemp -d)"
+trap 'rm -rf "$workdir"' EXIT
+
+export TERMINFO="$workdir/terminfo"
+export HOME="$workdir"
+unset TERMINFO_DIRS
+
+u16() {
+    printf "$(printf '\\%03o\\%03o' $(( $1 & 255 )) $(( ($1 >> 8) & 255 )))"
+}
+
+number() {
+    u16 "$1"
+    if (( size == 4 )); then
+        u16 $(( $1 >> 16 ))
+    fi
+}
+
+# Compile an entry for TERM by hand, with numbers of SIZE bytes (2 for the
+# legacy format and 4 for the 32-bit one) and the given number of colors
+write_entry() {
+    local term="$1" size="$2" colors="$3"
+    local names="$term|rainbowpath test entry"
+    local -A strings=(
+        [27]=$'\e[1m'
+        [36]=$'\e[4m'
+        [39]=$'\e(B\e[m'
+        [359]=$'\e[%?%p1%{8}%<%t3%p1%d%e%p1%{16}%<%t9%p1%{8}%-%d%e38;5;%p1%d%;m'
+        [360]=$'\e[%?%p1%{8}%<%t4%p1%d%e%p1%{16}%<%t10%p1%{8}%-%d%e48;5;%p1%d%;m'
+    )
+    local table="" offsets=()
+    for i in $(seq 0 360); do
+        if [[ -v strings[$i] ]]; then
+            offsets+=("${#table}")
+            table+="${strings[$i]}"$'\x01'
+        else
+            offsets+=(65535)
+        fi
+    done
+    mkdir -p "$TERMINFO/${term:0:1}"
+    {
+        u16 $(( size == 2 ? 0432 : 01036 ))
+        u16 $(( ${#names} + 1 ))
+        u16 0
+        u16 14
+        u16 361
+        u16 "${#table}"
+        printf '%s\0' "$names"
+        if (( (${#names} + 1) % 2 )); then
+            printf '\0'
+        fi
+        for i in $(seq 13); do
+            number -1
+        done
+        number "$colors"
+        for offset in "${offsets[@]}"; do
+            u16 "$offset"
+        done
+        # Strings are written separated by \x01 to keep them in a shell
+        # variable and terminated by NUL in the entry
+        printf '%s' "$table" | tr '\001' '\000'
+    } > "$TERMINFO/${term:0:1}/$term"
+}
+
+expect() {
+    local expected="$1"
+    shift
+    cmp <(printf '%s' "$expected") <("$TEST_TERMINFO" "$@")
+}
+
+write_entry rbtest-legacy 2 256
+write_entry rbtest-direct 4 16777216
+
+for term in rbtest-legacy rbtest-direct; do
+    expect $'\e[31m' "$term" setaf 1
+    expect $'\e[94m' "$term" setaf 12
+    expect $'\e[38;5;200m' "$term" setaf 200
+    expect $'\e[42m' "$term" setab 2
+    expect $'\e[1m' "$term" bold
+    expect $'\e(B\e[m' "$term" sgr0
+    ! "$TEST_TERMINFO" "$term" dim > /dev/null || exit 1
+done
+expect $'256\n' rbtest-legacy colors
+expect $'16777216\n' rbtest-direct colors
+
+# Parameterized strings
+expect 42 --expand '%p1%d' 42
+expect 17 --expand '%p1%{3}%*%{2}%+%d' 5
+expect 2:1 --expand '%p1%{4}%/%d:%p1%{4}%m%d' 9
+expect 5 --expand '%i%p1%d' 4
+expect 0a --expand '%p1%02x' 10
+expect A% --expand '%p1%c%%' 65
+expect 14 --expand '%p1%Pa%ga%ga%+%d' 7
+expect x --expand '$<5>x' 0
+expect 1 --expand '%?%p1%{1}%=%t1%e%p1%{2}%=%t2%e3%;' 1
+expect 2 --expand '%?%p1%{1}%=%t1%e%p1%{2}%=%t2%e3%;' 2
+expect 3 --expand '%?%p1%{1}%=%t1%e%p1%{2}%=%t2%e3%;' 7
+expect yes --expand '%?%p1%{3}%>%p1%{9}%<%A%tyes%eno%;' 5
+
+# The same entries, and those installed on the system, are read by ncurses
+# identically
+if ! command -v tput > /dev/null; then
+    exit 0
+fi
+for term in xterm-256color linux; do
+    for directory in /etc/terminfo /lib/terminfo /usr/share/terminfo; do
+        if [[ -f "$directory/${term:0:1}/$term" ]]; then
+            mkdir -p "$TERMINFO/${term:0:1}"
+            cp "$directory/${term:0:1}/$term" "$TERMINFO/${term:0:1}/"
+            break
+        fi
+    done
+done
+for term in rbtest-legacy rbtest-direct xterm-256color linux; do
+    if [[ ! -f "$TERMINFO/${term:0:1}/$term" ]]; then
+        continue
+    fi
+    cmp <(tput -T "$term" colors) <("$TEST_TERMINFO" "$term" colors)
+    for color in 0 1 7 8 9 15 16 100 255; do
+        cmp <(tput -T "$term" setaf "$color") <("$TEST_TERMINFO" "$term" setaf "$color")
+        cmp <(tput -T "$term" setab "$color") <("$TEST_TERMINFO" "$term" setab "$color")
+    done
+    for capability in bold sgr0; do
+        cmp <(tput -T "$term" "$capability") <("$TEST_TERMINFO" "$term" "$capability")
+    done
+done
@@ -0,0 +1,77 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+// Run a command under ptrace and print the number of system calls it made.
+// The output of the command is discarded. Exits with 77, the Automake code
+// for skipped tests, if tracing is not permitted.
+
+enum {
+  EXIT_SKIP = 77
+};
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fputs("Usage: syscall_count COMMAND [ARGS...]\n", stderr);
+    return EXIT_FAILURE;
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    return EXIT_FAILURE;
+  }
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0 || dup2(null, STDOUT_FILENO) < 0 || dup2(null, STDERR_FILENO) < 0) {
+      _exit(EXIT_FAILURE);
+    }
+    if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) {
+      _exit(EXIT_SKIP);
+    }
+    raise(SIGSTOP);
+    execvp(argv[1], argv + 1);
+    _exit(EXIT_FAILURE);
+  }
+  int status;
+  if (waitpid(pid, &status, 0) < 0) {
+    return EXIT_FAILURE;
+  }
+  if (WIFEXITED(status)) {
+    return WEXITSTATUS(status);
+  }
+  if (ptrace(PTRACE_SETOPTIONS, pid, NULL,
+             PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL) != 0) {
+    kill(pid, SIGKILL);
+    return EXIT_SKIP;
+  }
+  // Every system call stops the tracee twice, on entry and on exit
+  unsigned long stops = 0;
+  int signal = 0;
+  while (true) {
+    if (ptrace(PTRACE_SYSCALL, pid, NULL, signal) != 0) {
+      return EXIT_FAILURE;
+    }
+    if (waitpid(pid, &status, 0) < 0) {
+      return EXIT_FAILURE;
+    }
+    signal = 0;
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+      break;
+    }
+    if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+      stops++;
+    } else if (WSTOPSIG(status) != SIGTRAP) {
+      signal = WSTOPSIG(status);
+    }
+  }
+  // The final exit_group never returns
+  printf("%lu\n", (stops + 1) / 2);
+  if (WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,50 +1,68 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
+#include "arena.h"
 #include "style_parser.h"
 #include "config_parser.h"
 #include "styles.h"
 #include "utils.h"
 
+static bool accept_option(UNUSED void *ctx, UNUSED const struct string_view *name) {
+  return true;
+}
+
+static bool ignore_option(UNUSED void *ctx, UNUSED struct option *option) {
+  return true;
+}
+
 int main(int argc, char *argv[]) {
   int ret = EXIT_FAILURE;
-  char *input = NULL;
-  size_t length;
+  struct arena *arena = arena_create();
+  struct stat buf;
+  struct mapped_file file;
+  bool mapped = false;
   if (argc != 2) {
     goto out;
   }
-  if (!read_stream(stdin, &input, &length)) {
+  if (fstat(STDIN_FILENO, &buf) != 0 || !map_file(STDIN_FILENO, &buf, &file)) {
     goto out;
   }
+  mapped = true;
+  const char *input = file.data;
+  size_t length = file.length;
   if (!strcmp(argv[1], "style")) {
     struct style *style;
-    const char *pos = parse_style(input, input + length, &style);
+    const char *pos = parse_style(arena, input, input + length, &style);
     if (!pos) {
       goto out;
     }
-    free(style);
   } else if (!strcmp(argv[1], "palette")) {
     struct palette *palette;
-    const char *pos = parse_palette(input, input + length, &palette);
+    const char *pos = parse_palette(arena, input, input + length, &palette);
     if (!pos) {
       goto out;
     }
-    palette_free(palette);
   } else if (!strcmp(argv[1], "config")) {
-    struct list *options;
-    const char *pos = parse_config(input, input + length, &options);
+    const struct config_handler handler = {
+      .accept = accept_option,
+      .option = ignore_option,
+      .ctx = NULL,
+    };
+    const char *pos = parse_config(arena, input, input + length, &handler);
     if (!pos) {
       goto out;
     }
-    list_free(options, (elem_free_t)option_free);
   } else {
     goto out;
   }
   ret = EXIT_SUCCESS;
  out:
-  if (input) {
-    free(input);
+  arena_free(arena);
+  if (mapped) {
+    unmap_file(&file);
   }
   return ret;
 }
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "terminfo.h"
+#include "utils.h"
+
+// Prints capabilities the way tput does, so that the output can be compared
+// with that of ncurses:
+//
+//   test_terminfo TERM colors
+//   test_terminfo TERM CAPABILITY [PARAM]
+//   test_terminfo --expand STRING PARAM
+
+static const char *CAPABILITIES[TERMINFO_STRING_COUNT] = {
+  [TERMINFO_SETAF] = "setaf",
+  [TERMINFO_SETAB] = "setab",
+  [TERMINFO_BOLD] = "bold",
+  [TERMINFO_DIM] = "dim",
+  [TERMINFO_SMUL] = "smul",
+  [TERMINFO_BLINK] = "blink",
+  [TERMINFO_SGR0] = "sgr0",
+};
+
+static void print_expanded(const char *cap, int param) {
+  char sequence[256];
+  size_t length = terminfo_expand(cap, param, sequence, sizeof(sequence));
+  fwrite(sequence, 1, length, stdout);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3 || argc > 4) {
+    return EXIT_FAILURE;
+  }
+  int param = argc == 4 ? atoi(argv[3]) : 0;
+  if (!strcmp(argv[1], "--expand")) {
+    print_expanded(argv[2], param);
+    return EXIT_SUCCESS;
+  }
+  struct terminfo terminfo;
+  if (!terminfo_load(argv[1], &terminfo)) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+  if (!strcmp(argv[2], "colors")) {
+    printf("%d\n", terminfo.colors);
+    ret = EXIT_SUCCESS;
+  }
+  for (size_t i = 0; i < ARRAY_SIZE(CAPABILITIES); i++) {
+    if (!strcmp(argv[2], CAPABILITIES[i]) && terminfo.strings[i]) {
+      print_expanded(terminfo.strings[i], param);
+      ret = EXIT_SUCCESS;
+    }
+  }
+  terminfo_free(&terminfo);
+  return ret;
+}